@@ -0,0 +1,68 @@
+#include <tet_api.h>
+#define LOG_TAG "DLOG_TEST"
+#define LOG_MIN_PRIORITY DLOG_DEBUG
+#include "dlog.h"
+static void startup(void);
+static void cleanup(void);
+
+void (*tet_startup)(void) = startup;
+void (*tet_cleanup)(void) = cleanup;
+
+static void utc_ApplicationFW_LOG_MIN_PRIORITY_func_01(void);
+static void utc_ApplicationFW_LOG_MIN_PRIORITY_func_02(void);
+
+enum {
+	POSITIVE_TC_IDX = 0x01,
+	NEGATIVE_TC_IDX,
+};
+
+struct tet_testlist tet_testlist[] = {
+	{ utc_ApplicationFW_LOG_MIN_PRIORITY_func_01, POSITIVE_TC_IDX },
+	{ utc_ApplicationFW_LOG_MIN_PRIORITY_func_02, NEGATIVE_TC_IDX },
+	{ NULL, 0 }
+};
+
+static int evaluated;
+
+static void startup(void)
+{
+	evaluated = 0;
+}
+
+static void cleanup(void)
+{
+}
+
+/**
+ * @brief Positive test case of LOG_MIN_PRIORITY, a call at the floor is kept
+ */
+static void utc_ApplicationFW_LOG_MIN_PRIORITY_func_01(void)
+{
+	evaluated = 0;
+	LOGD("dlog test message for tetware %d\n", ++evaluated);
+
+	if (evaluated != 1) {
+		tet_printf("LOG_MIN_PRIORITY failed in positive test case");
+		tet_result(TET_FAIL);
+		return;
+	}
+	tet_result(TET_PASS);
+}
+
+/**
+ * @brief Negative test case of LOG_MIN_PRIORITY, a call below the floor
+ * is compiled out and its arguments are not evaluated
+ */
+static void utc_ApplicationFW_LOG_MIN_PRIORITY_func_02(void)
+{
+	evaluated = 0;
+	LOGV("dlog test message for tetware %d\n", ++evaluated);
+	LOGV_IF(1, "dlog test message for tetware %d\n", ++evaluated);
+
+	if (evaluated != 0) {
+		tet_printf("LOG_MIN_PRIORITY failed in negative test case");
+		tet_result(TET_FAIL);
+		return;
+	}
+	tet_result(TET_PASS);
+}
@@ -0,0 +1,97 @@
+#include <tet_api.h>
+#include <string.h>
+#include "dlog.h"
+static void startup(void);
+static void cleanup(void);
+
+void (*tet_startup)(void) = startup;
+void (*tet_cleanup)(void) = cleanup;
+
+static void utc_ApplicationFW___dlog_callsite_check_func_01(void);
+static void utc_ApplicationFW___dlog_callsite_check_func_02(void);
+static void utc_ApplicationFW___dlog_callsite_check_func_03(void);
+
+enum {
+	POSITIVE_TC_IDX = 0x01,
+	NEGATIVE_TC_IDX,
+};
+
+struct tet_testlist tet_testlist[] = {
+	{ utc_ApplicationFW___dlog_callsite_check_func_01, POSITIVE_TC_IDX },
+	{ utc_ApplicationFW___dlog_callsite_check_func_02, NEGATIVE_TC_IDX },
+	{ utc_ApplicationFW___dlog_callsite_check_func_03, NEGATIVE_TC_IDX },
+	{ NULL, 0 }
+};
+
+static void startup(void)
+{
+}
+
+static void cleanup(void)
+{
+}
+
+/**
+ * @brief Positive test case of __dlog_callsite_check()
+ */
+static void utc_ApplicationFW___dlog_callsite_check_func_01(void)
+{
+	struct dlog_callsite site;
+	int i, r = 0;
+
+	memset(&site, 0, sizeof(site));
+	for (i = 0; i < 4; i++)
+		r = __dlog_callsite_check(&site, 4, 0);
+	r = __dlog_callsite_check(&site, 4, 0);
+
+	if (r != 3) {
+		tet_printf("__dlog_callsite_check() failed in positive test case");
+		tet_result(TET_FAIL);
+		return;
+	}
+	tet_result(TET_PASS);
+}
+
+/**
+ * @brief Negative test case of __dlog_callsite_check()
+ */
+static void utc_ApplicationFW___dlog_callsite_check_func_02(void)
+{
+	struct dlog_callsite site;
+	int r = 0;
+
+	memset(&site, 0, sizeof(site));
+	__dlog_callsite_check(&site, 0, 0);
+	r = __dlog_callsite_check(&site, 0, 0);
+
+	if (r >= 0) {
+		tet_printf("__dlog_callsite_check() failed in negative test case");
+		tet_result(TET_FAIL);
+		return;
+	}
+	tet_result(TET_PASS);
+}
+
+/**
+ * @brief Negative test case of __dlog_callsite_check() with an interval of 0
+ */
+static void utc_ApplicationFW___dlog_callsite_check_func_03(void)
+{
+	struct dlog_callsite site;
+	int i, r = 0;
+
+	/* LOGx_EVERY_N(0, ...) and LOGx_EVERY_MS(0, ...) log once */
+	memset(&site, 0, sizeof(site));
+	if (__dlog_callsite_check(&site, 0, 0) != 0)
+		r = 1;
+	for (i = 0; i < 10; i++)
+		if (__dlog_callsite_check(&site, 0, 0) >= 0)
+			r = 1;
+
+	if (r || site.suppressed != 10) {
+		tet_printf("__dlog_callsite_check() failed in negative test case");
+		tet_result(TET_FAIL);
+		return;
+	}
+	tet_result(TET_PASS);
+}
@@ -0,0 +1,543 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * End-to-end load generator: -p processes of -T threads each write
+ * messages through __dlog_print for -d seconds, while a reader command,
+ * dlogutil by default, follows the log. Every message carries its
+ * writer, sequence number and send time, so the lines coming out of the
+ * reader give the sustained rate, the latency from __dlog_print to the
+ * reader's output, and how many messages were lost on the way.
+ *
+ * Without /dev/log_main, or with -S, the writers put records laid out as
+ * libdlog writes them into a stand-in buffer instead: a ring in shared
+ * memory that overwrites its oldest records like the log driver, read by
+ * the generator itself. This measures the writers and the machine rather
+ * than dlogutil, but runs on any Linux box.
+ *
+ * usage: dlog-loadgen [-p <processes>] [-T <threads>] [-d <seconds>]
+ *        [-r <rate>] [-l <len>[-<max len>]] [-P <priorities>] [-t <tags>]
+ *        [-c <reader command>] [-S]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <dlog.h>
+#include <logger.h>
+
+#define STANDIN_RING_SIZE	(256 * 1024)
+#define MAX_MSG_LEN		3072
+#define DRAIN_IDLE_MSEC		1000
+#define DRAIN_MAX_MSEC		10000
+
+static int g_processes = 1;
+static int g_threads = 1;
+static int g_seconds = 5;
+static int g_rate = 1000;		/* per thread, 0 means "as fast as possible" */
+static int g_min_len = 64;
+static int g_max_len = 64;
+static const char* g_priorities = "DIWE";
+static int g_tags = 1;
+static const char* g_reader = "dlogutil -v raw -b main";
+static int g_standin = 0;
+
+/*
+ * The stand-in buffer. Offsets count bytes ever written, and the ring
+ * holds those from oldest to head.
+ */
+struct standin_ring_t {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint64_t head;
+	uint64_t oldest;
+	int writers_done;
+	unsigned char data[STANDIN_RING_SIZE];
+};
+
+static struct standin_ring_t* g_ring;
+static unsigned int g_run;		/* tells this run's messages from older ones */
+
+/* shared with the writer processes */
+static volatile unsigned long* g_sent;
+
+/* written by the reader thread only */
+static unsigned long* g_received;
+static uint32_t* g_latency_usec;
+static size_t g_latency_count;
+static size_t g_latency_size;
+static volatile unsigned long g_received_total;
+static volatile int64_t g_last_received;
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dlog-loadgen [<option>] ...\n"
+			"  -p <processes>  writer processes, default 1\n"
+			"  -T <threads>    writer threads per process, default 1\n"
+			"  -d <seconds>    how long to write, default 5\n"
+			"  -r <rate>       messages per second per thread, or 0 for as\n"
+			"                  many as possible, default 1000\n"
+			"  -l <len>[-<max>] message length, or a range, default 64\n"
+			"  -P <priorities> priority letters to pick from, default DIWE\n"
+			"  -t <tags>       distinct tags to spread messages over, default 1\n"
+			"  -c <command>    reader to run, default 'dlogutil -v raw -b main'\n"
+			"  -S              use the stand-in buffer even if /dev/log_main exists\n");
+	exit(-1);
+}
+
+static int64_t monotonic_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int priority_of(char c)
+{
+	switch (c) {
+		case 'V': return DLOG_VERBOSE;
+		case 'D': return DLOG_DEBUG;
+		case 'I': return DLOG_INFO;
+		case 'W': return DLOG_WARN;
+		case 'E': return DLOG_ERROR;
+		case 'F': return DLOG_FATAL;
+		default: return -1;
+	}
+}
+
+static void ring_copy_in(uint64_t off, const void* src, size_t len)
+{
+	size_t pos = off % STANDIN_RING_SIZE;
+	size_t first = len < STANDIN_RING_SIZE - pos ? len : STANDIN_RING_SIZE - pos;
+
+	memcpy(g_ring->data + pos, src, first);
+	memcpy(g_ring->data, (const char *)src + first, len - first);
+}
+
+static void ring_copy_out(uint64_t off, void* dst, size_t len)
+{
+	size_t pos = off % STANDIN_RING_SIZE;
+	size_t first = len < STANDIN_RING_SIZE - pos ? len : STANDIN_RING_SIZE - pos;
+
+	memcpy(dst, g_ring->data + pos, first);
+	memcpy((char *)dst + first, g_ring->data, len - first);
+}
+
+static void ring_init(void)
+{
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
+
+	g_ring = (struct standin_ring_t *)mmap(NULL, sizeof(*g_ring), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (g_ring == MAP_FAILED) {
+		fprintf(stderr, "Can't malloc stand-in buffer\n");
+		exit(-1);
+	}
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&g_ring->lock, &mattr);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&g_ring->cond, &cattr);
+}
+
+/* writes one record as libdlog would, to the stand-in buffer */
+static void standin_write(int prio, const char* tag, const char* msg)
+{
+	struct logger_entry entry;
+	struct timespec ts;
+	unsigned char p = prio;
+	size_t tag_len = strlen(tag) + 1, msg_len = strlen(msg) + 1;
+	size_t len = sizeof(entry) + 1 + tag_len + msg_len;
+	struct logger_entry old;
+	uint64_t off;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memset(&entry, 0, sizeof(entry));
+	entry.len = 1 + tag_len + msg_len;
+	entry.pid = getpid();
+	entry.tid = 0;
+	entry.sec = ts.tv_sec;
+	entry.nsec = ts.tv_nsec;
+
+	pthread_mutex_lock(&g_ring->lock);
+	// like the driver, overwrite whole records from the oldest on
+	while (g_ring->head + len - g_ring->oldest > STANDIN_RING_SIZE) {
+		ring_copy_out(g_ring->oldest, &old, sizeof(old));
+		g_ring->oldest += sizeof(old) + old.len;
+	}
+	off = g_ring->head;
+	ring_copy_in(off, &entry, sizeof(entry));
+	ring_copy_in(off + sizeof(entry), &p, 1);
+	ring_copy_in(off + sizeof(entry) + 1, tag, tag_len);
+	ring_copy_in(off + sizeof(entry) + 1 + tag_len, msg, msg_len);
+	g_ring->head += len;
+	pthread_cond_signal(&g_ring->cond);
+	pthread_mutex_unlock(&g_ring->lock);
+}
+
+struct writer_arg_t {
+	int writer;
+	int64_t start;
+};
+
+static void* writer_thread(void* arg)
+{
+	struct writer_arg_t* w = (struct writer_arg_t *)arg;
+	char msg[MAX_MSG_LEN + 64];
+	char tag[32];
+	unsigned int seed = w->writer + 1;
+	struct timespec ts;
+	int64_t now, due = w->start, end = w->start + (int64_t)g_seconds * 1000000000;
+	unsigned long seq;
+	int len, n, prio;
+
+	for (seq = 1; (now = monotonic_nsec()) < end; seq++) {
+		if (g_rate > 0) {
+			due += 1000000000 / g_rate;
+			ts.tv_sec = due / 1000000000;
+			ts.tv_nsec = due % 1000000000;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+				;
+			now = monotonic_nsec();
+		}
+
+		len = g_min_len + (g_max_len > g_min_len ? rand_r(&seed) % (g_max_len - g_min_len + 1) : 0);
+		n = snprintf(msg, sizeof(msg), "lg %u %d %lu %lld ", g_run, w->writer, seq, (long long)now);
+		if (n < len) {
+			memset(msg + n, 'x', len - n);
+			n = len;
+		}
+		msg[n] = '\0';
+		snprintf(tag, sizeof(tag), "LOADGEN%d", g_tags > 1 ? rand_r(&seed) % g_tags : 0);
+		prio = priority_of(g_priorities[rand_r(&seed) % strlen(g_priorities)]);
+
+		if (g_standin) {
+			standin_write(prio, tag, msg);
+		} else {
+			__dlog_print(LOG_ID_MAIN, prio, tag, "%s", msg);
+		}
+		g_sent[w->writer] = seq;
+	}
+
+	return NULL;
+}
+
+static void run_writers(int process, int64_t start)
+{
+	pthread_t threads[g_threads];
+	struct writer_arg_t args[g_threads];
+	int i;
+
+	for (i = 0; i < g_threads; i++) {
+		args[i].writer = process * g_threads + i;
+		args[i].start = start;
+		if (pthread_create(&threads[i], NULL, writer_thread, &args[i]) != 0) {
+			perror("pthread_create");
+			exit(-1);
+		}
+	}
+	for (i = 0; i < g_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	exit(0);
+}
+
+/* counts a message of this run found in text */
+static void receive(const char* text, int64_t now)
+{
+	unsigned int run;
+	int writer;
+	unsigned long seq;
+	long long sent;
+	uint32_t* grown;
+
+	text = strstr(text, "lg ");
+	if (text == NULL || sscanf(text, "lg %u %d %lu %lld", &run, &writer, &seq, &sent) != 4
+			|| run != g_run || writer < 0 || writer >= g_processes * g_threads) {
+		return;
+	}
+
+	if (g_latency_count == g_latency_size) {
+		g_latency_size = g_latency_size ? 2 * g_latency_size : 65536;
+		grown = (uint32_t *)realloc(g_latency_usec, g_latency_size * sizeof(uint32_t));
+		if (grown == NULL) {
+			fprintf(stderr, "Can't malloc latencies\n");
+			exit(-1);
+		}
+		g_latency_usec = grown;
+	}
+	g_latency_usec[g_latency_count++] = now > sent ? (uint32_t)((now - sent) / 1000) : 0;
+	g_received[writer]++;
+	g_received_total++;
+	g_last_received = now;
+}
+
+/* reads the reader command's output until it ends */
+static void* text_reader_thread(void* arg)
+{
+	FILE* in = (FILE *)arg;
+	char line[MAX_MSG_LEN + 256];
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		receive(line, monotonic_nsec());
+	}
+
+	return NULL;
+}
+
+/* reads stand-in records until the writers are done and it is empty */
+static void* standin_reader_thread(void* arg)
+{
+	static union {
+		unsigned char buf[LOGGER_ENTRY_MAX_LEN + 1] __attribute__((aligned(4)));
+		struct logger_entry entry __attribute__((aligned(4)));
+	} record;
+	uint64_t off = 0;
+	size_t tag_len;
+
+	(void)arg;
+	pthread_mutex_lock(&g_ring->lock);
+	while (1) {
+		while (off == g_ring->head && !g_ring->writers_done) {
+			pthread_cond_wait(&g_ring->cond, &g_ring->lock);
+		}
+		if (off == g_ring->head) {
+			break;
+		}
+		// what was overwritten shows up as missing sequence numbers
+		if (off < g_ring->oldest) {
+			off = g_ring->oldest;
+		}
+		ring_copy_out(off, &record.entry, sizeof(record.entry));
+		ring_copy_out(off + sizeof(record.entry), record.entry.msg, record.entry.len);
+		off += sizeof(record.entry) + record.entry.len;
+		pthread_mutex_unlock(&g_ring->lock);
+
+		record.entry.msg[record.entry.len] = '\0';
+		tag_len = strlen(record.entry.msg + 1);
+		receive(record.entry.msg + 2 + tag_len, monotonic_nsec());
+
+		pthread_mutex_lock(&g_ring->lock);
+	}
+	pthread_mutex_unlock(&g_ring->lock);
+
+	return NULL;
+}
+
+/* starts command with its output on a pipe, returning its pid */
+static pid_t start_reader(const char* command, FILE** out)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		exit(-1);
+	}
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(-1);
+	}
+	if (pid == 0) {
+		// in a group of its own, so that stopping it stops all of it
+		setpgid(0, 0);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+		_exit(127);
+	}
+	close(fds[1]);
+	*out = fdopen(fds[0], "r");
+	if (*out == NULL) {
+		perror("fdopen");
+		exit(-1);
+	}
+
+	return pid;
+}
+
+static int cmp_u32(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(double p)
+{
+	size_t i;
+
+	if (g_latency_count == 0) {
+		return 0;
+	}
+	i = (size_t)(p / 100 * (g_latency_count - 1) + 0.5);
+	return g_latency_usec[i] / 1000.0;
+}
+
+static void report(double seconds)
+{
+	unsigned long sent = 0, received = 0, lost = 0;
+	int i, writers = g_processes * g_threads;
+
+	for (i = 0; i < writers; i++) {
+		sent += g_sent[i];
+		received += g_received[i];
+		if (g_sent[i] > g_received[i]) {
+			lost += g_sent[i] - g_received[i];
+		}
+	}
+	qsort(g_latency_usec, g_latency_count, sizeof(uint32_t), cmp_u32);
+
+	printf("buffer:     %s\n", g_standin ? "stand-in" : "/dev/log_main");
+	printf("writers:    %d x %d, %d s, %d msg/s each%s\n", g_processes, g_threads, g_seconds,
+			g_rate, g_rate ? "" : " (unlimited)");
+	printf("sent:       %lu (%.0f msg/s)\n", sent, sent / (double)g_seconds);
+	printf("received:   %lu (%.0f msg/s over %.3f s)\n", received, received / seconds, seconds);
+	printf("lost:       %lu (%.3f%%)\n", lost, sent ? 100.0 * lost / sent : 0.0);
+	printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+			percentile(50), percentile(90), percentile(99), percentile(99.9), percentile(100));
+}
+
+int main(int argc, char** argv)
+{
+	pthread_t reader;
+	FILE* reader_out = NULL;
+	pid_t reader_pid = -1;
+	pid_t* pids;
+	int64_t start, last_change, now;
+	unsigned long last_total;
+	int i, c, status, writers;
+	char* dash;
+
+	while ((c = getopt(argc, argv, "p:T:d:r:l:P:t:c:S")) != -1) {
+		switch (c) {
+			case 'p': g_processes = atoi(optarg); break;
+			case 'T': g_threads = atoi(optarg); break;
+			case 'd': g_seconds = atoi(optarg); break;
+			case 'r': g_rate = atoi(optarg); break;
+			case 'l':
+				g_min_len = g_max_len = atoi(optarg);
+				dash = strchr(optarg, '-');
+				if (dash) {
+					g_max_len = atoi(dash + 1);
+				}
+				break;
+			case 'P': g_priorities = optarg; break;
+			case 't': g_tags = atoi(optarg); break;
+			case 'c': g_reader = optarg; break;
+			case 'S': g_standin = 1; break;
+			default: usage();
+		}
+	}
+	if (optind != argc || g_processes <= 0 || g_threads <= 0 || g_seconds <= 0 || g_rate < 0
+			|| g_min_len < 0 || g_max_len < g_min_len || g_max_len > MAX_MSG_LEN
+			|| g_tags <= 0 || !*g_priorities) {
+		usage();
+	}
+	for (i = 0; g_priorities[i]; i++) {
+		if (priority_of(g_priorities[i]) < 0) {
+			usage();
+		}
+	}
+	if (access("/dev/log_main", W_OK) < 0) {
+		g_standin = 1;
+	}
+
+	g_run = (unsigned int)getpid();
+	writers = g_processes * g_threads;
+	g_sent = (volatile unsigned long *)mmap(NULL, writers * sizeof(unsigned long),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	g_received = (unsigned long *)calloc(writers, sizeof(unsigned long));
+	pids = (pid_t *)calloc(g_processes, sizeof(pid_t));
+	if (g_sent == MAP_FAILED || g_received == NULL || pids == NULL) {
+		fprintf(stderr, "Can't malloc counters\n");
+		exit(-1);
+	}
+
+	if (g_standin) {
+		ring_init();
+		if (pthread_create(&reader, NULL, standin_reader_thread, NULL) != 0) {
+			perror("pthread_create");
+			exit(-1);
+		}
+	} else {
+		reader_pid = start_reader(g_reader, &reader_out);
+		if (pthread_create(&reader, NULL, text_reader_thread, reader_out) != 0) {
+			perror("pthread_create");
+			exit(-1);
+		}
+		// let the reader get through what is already in the buffer
+		usleep(500000);
+	}
+
+	start = monotonic_nsec();
+	for (i = 0; i < g_processes; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			perror("fork");
+			exit(-1);
+		}
+		if (pids[i] == 0) {
+			run_writers(i, start);
+		}
+	}
+	for (i = 0; i < g_processes; i++) {
+		waitpid(pids[i], &status, 0);
+	}
+	if (g_standin) {
+		pthread_mutex_lock(&g_ring->lock);
+		g_ring->writers_done = 1;
+		pthread_cond_signal(&g_ring->cond);
+		pthread_mutex_unlock(&g_ring->lock);
+	}
+
+	// wait for the stragglers, until nothing new came for a while
+	last_total = g_received_total;
+	last_change = now = monotonic_nsec();
+	while (!g_standin && now - last_change < (int64_t)DRAIN_IDLE_MSEC * 1000000
+			&& now - start < ((int64_t)g_seconds * 1000 + DRAIN_MAX_MSEC) * 1000000) {
+		usleep(10000);
+		now = monotonic_nsec();
+		if (g_received_total != last_total) {
+			last_total = g_received_total;
+			last_change = now;
+		}
+	}
+	if (reader_pid > 0) {
+		kill(-reader_pid, SIGTERM);
+		waitpid(reader_pid, &status, 0);
+	}
+	pthread_join(reader, NULL);
+
+	report(g_received_total ? (g_last_received - start) / 1e9 : g_seconds);
+
+	return 0;
+}
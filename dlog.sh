@@ -1,2 +1,2 @@
 #!/bin/sh
-/usr/bin/dlogutil -r 51200 -n 1 -f /var/log/dlog -v threadtime *:* &
+/usr/bin/dlogutil -q 1024 -m 51200 -f /var/log/dlog -v threadtime *:* &
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a captured log through libdlog, for load testing dlogutil and
+ * sizing the log buffers with a real workload. Every record is written
+ * again with its buffer, priority and tag, at the same distance in time
+ * from the first record as in the capture, divided by the speed.
+ *
+ * The capture is either a binary capture written by dlogutil -B or -S,
+ * or the text of dlogutil -v threadtime. With -p, the records are shared
+ * out to that many processes by their original pid, so that each writer
+ * of the capture is replayed by one process, in its order.
+ *
+ * usage: dlogreplay [-s <speed>] [-p <processes>] [-b <buffer>] <capture>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <dlog.h>
+#include <logbinary.h>
+
+struct replay_record_t {
+	int64_t nsec;
+	int32_t pid;
+	log_id_t log_id;
+	int prio;
+	const char* tag;
+	const char* msg;
+};
+
+struct replay_source_t {
+	int fd;
+	FILE* text;			/* threadtime text, else a binary capture */
+	char* line;
+	size_t line_size;
+	log_id_t text_log_id;		/* buffer of the last "beginning of" line */
+	struct log_binary_reader_t binary;
+	union {
+		unsigned char buf[LOGGER_ENTRY_MAX_LEN + 1] __attribute__((aligned(4)));
+		struct logger_entry entry __attribute__((aligned(4)));
+	} record;
+};
+
+static double g_speed = 1.0;		/* 0 means "as fast as possible" */
+static int g_processes = 1;
+static int g_log_id = -1;		/* -1 means "the buffer of the record" */
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dlogreplay [-s <speed>] [-p <processes>] [-b <buffer>] <capture>\n"
+			"  -s <speed>      replay <speed> times as fast, or 0 for as fast as\n"
+			"                  possible, default 1\n"
+			"  -p <processes>  replay from <processes> processes, default 1\n"
+			"  -b <buffer>     write every record to <buffer> ('main', 'radio',\n"
+			"                  'system' or 'apps') instead of its own\n");
+	exit(-1);
+}
+
+/* maps "main", "log_main" or "/dev/log_main" to its log id, -1 if unknown */
+static int buffer_log_id(const char* name)
+{
+	static const char* const names[LOG_ID_MAX] = { "main", "radio", "system", "apps" };
+	int i;
+
+	if (!strncmp(name, "/dev/", 5)) {
+		name += 5;
+	}
+	if (!strncmp(name, "log_", 4)) {
+		name += 4;
+	}
+	for (i = 0; i < LOG_ID_MAX; i++) {
+		if (!strcmp(name, names[i])) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static int priority_of(char c)
+{
+	switch (c) {
+		case 'V': return DLOG_VERBOSE;
+		case 'D': return DLOG_DEBUG;
+		case 'I': return DLOG_INFO;
+		case 'W': return DLOG_WARN;
+		case 'E': return DLOG_ERROR;
+		case 'F': return DLOG_FATAL;
+		case 'S': return DLOG_SILENT;
+		default: return -1;
+	}
+}
+
+static void open_source(struct replay_source_t* src, const char* path)
+{
+	memset(src, 0, sizeof(*src));
+	src->fd = open(path, O_RDONLY);
+	if (src->fd < 0) {
+		fprintf(stderr, "Unable to open '%s': %s\n", path, strerror(errno));
+		exit(-1);
+	}
+	if (log_binary_open(&src->binary, src->fd) == 0) {
+		log_binary_map(&src->binary);
+		return;
+	}
+
+	// not a binary capture: read it as threadtime text from the start
+	if (lseek(src->fd, 0, SEEK_SET) < 0 || (src->text = fdopen(src->fd, "r")) == NULL) {
+		fprintf(stderr, "Unable to read '%s': %s\n", path, strerror(errno));
+		exit(-1);
+	}
+	src->text_log_id = LOG_ID_MAIN;
+}
+
+/* splits a binary capture record into priority, tag and message */
+static int next_binary(struct replay_source_t* src, struct replay_record_t* rec)
+{
+	struct logger_entry* entry = &src->record.entry;
+	size_t tag_len;
+	int buffer, ret, n;
+
+	while ((ret = log_binary_read(&src->binary, &buffer, entry)) > 0) {
+		if (entry->len < 3) {
+			continue;
+		}
+		entry->msg[entry->len] = '\0';
+		tag_len = strnlen(entry->msg + 1, entry->len - 1);
+		if (tag_len + 2 >= entry->len) {
+			continue;
+		}
+		rec->nsec = (int64_t)entry->sec * 1000000000 + entry->nsec;
+		rec->pid = entry->pid;
+		// captures of other sources, like "-", are replayed to main
+		n = buffer_log_id(src->binary.buffers[buffer]);
+		rec->log_id = n < 0 ? LOG_ID_MAIN : (log_id_t)n;
+		rec->prio = (unsigned char)entry->msg[0];
+		rec->tag = entry->msg + 1;
+		// the message ends at its NUL, before any sequence trailer
+		rec->msg = entry->msg + 2 + tag_len;
+		return 1;
+	}
+
+	return ret;
+}
+
+/*
+ * Parses the next line of threadtime text,
+ *	MM-DD HH:MM:SS.mmm  PID  TID P TAG     : message
+ * skipping the lines that aren't records.
+ */
+static int next_text(struct replay_source_t* src, struct replay_record_t* rec)
+{
+	static const char beginning[] = "--------- beginning of ";
+	struct tm tm;
+	char* tag;
+	char* end;
+	char prio;
+	int mon, mday, hour, min, sec, msec, pid, tid, n;
+	ssize_t len;
+	time_t now = time(NULL);
+
+	while ((len = getline(&src->line, &src->line_size, src->text)) > 0) {
+		if (src->line[len - 1] == '\n') {
+			src->line[--len] = '\0';
+		}
+		if (!strncmp(src->line, beginning, sizeof(beginning) - 1)) {
+			n = buffer_log_id(src->line + sizeof(beginning) - 1);
+			src->text_log_id = n < 0 ? LOG_ID_MAIN : (log_id_t)n;
+			continue;
+		}
+		n = 0;
+		if (sscanf(src->line, "%d-%d %d:%d:%d.%d %d %d %c %n",
+				&mon, &mday, &hour, &min, &sec, &msec, &pid, &tid, &prio, &n) < 9 || n == 0
+				|| priority_of(prio) < 0) {
+			continue;
+		}
+		tag = src->line + n;
+		end = strstr(tag, ": ");
+		if (end == NULL) {
+			continue;
+		}
+		rec->msg = end + 2;
+		while (end > tag && end[-1] == ' ') {
+			end--;
+		}
+		*end = '\0';
+
+		// the year isn't printed; only the distance between records matters
+		localtime_r(&now, &tm);
+		tm.tm_mon = mon - 1;
+		tm.tm_mday = mday;
+		tm.tm_hour = hour;
+		tm.tm_min = min;
+		tm.tm_sec = sec;
+		tm.tm_isdst = -1;
+		rec->nsec = (int64_t)mktime(&tm) * 1000000000 + (int64_t)msec * 1000000;
+		rec->pid = pid;
+		rec->log_id = src->text_log_id;
+		rec->prio = priority_of(prio);
+		rec->tag = tag;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int next_record(struct replay_source_t* src, struct replay_record_t* rec)
+{
+	return src->text ? next_text(src, rec) : next_binary(src, rec);
+}
+
+static int64_t monotonic_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* replays the records of process number index, from start on */
+static void replay(const char* path, int index, int64_t start)
+{
+	struct replay_source_t src;
+	struct replay_record_t rec;
+	struct timespec ts;
+	int64_t first = 0, due, late, max_late = 0;
+	unsigned long count = 0, failed = 0;
+	int ret, started = 0;
+
+	open_source(&src, path);
+	while ((ret = next_record(&src, &rec)) > 0) {
+		// times count from the first record of all processes
+		if (!started) {
+			first = rec.nsec;
+			started = 1;
+		}
+		if ((unsigned int)rec.pid % g_processes != (unsigned int)index) {
+			continue;
+		}
+
+		if (g_speed > 0 && rec.nsec > first) {
+			due = start + (int64_t)((rec.nsec - first) / g_speed);
+			ts.tv_sec = due / 1000000000;
+			ts.tv_nsec = due % 1000000000;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+				;
+			late = monotonic_nsec() - due;
+			if (late > max_late) {
+				max_late = late;
+			}
+		}
+
+		if (__dlog_print(g_log_id >= 0 ? (log_id_t)g_log_id : rec.log_id, rec.prio, rec.tag, "%s", rec.msg) < 0) {
+			failed++;
+		} else {
+			count++;
+		}
+	}
+	if (ret < 0) {
+		fprintf(stderr, "%s: damaged record, stopping\n", path);
+	}
+
+	fprintf(stderr, "dlogreplay %d: %lu records in %.3f s, up to %.3f ms late, %lu failed to write\n",
+			index, count, (monotonic_nsec() - start) / 1e9, max_late / 1e6, failed);
+	exit(ret < 0 ? -1 : 0);
+}
+
+int main(int argc, char** argv)
+{
+	int64_t start;
+	pid_t pid;
+	int i, c, status, failed = 0;
+
+	while ((c = getopt(argc, argv, "s:p:b:")) != -1) {
+		switch (c) {
+			case 's':
+				g_speed = atof(optarg);
+				if (g_speed < 0) {
+					usage();
+				}
+				break;
+			case 'p':
+				g_processes = atoi(optarg);
+				if (g_processes <= 0) {
+					usage();
+				}
+				break;
+			case 'b':
+				g_log_id = buffer_log_id(optarg);
+				if (g_log_id < 0) {
+					usage();
+				}
+				break;
+			default:
+				usage();
+		}
+	}
+	if (optind + 1 != argc) {
+		usage();
+	}
+
+	// every process keeps to the same clock, so the writers interleave
+	// as they did in the capture
+	start = monotonic_nsec();
+	if (g_processes == 1) {
+		replay(argv[optind], 0, start);
+	}
+	for (i = 0; i < g_processes; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			exit(-1);
+		}
+		if (pid == 0) {
+			replay(argv[optind], i, start);
+		}
+	}
+	while (wait(&status) > 0) {
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			failed = 1;
+		}
+	}
+
+	return failed ? -1 : 0;
+}
@@ -103,6 +103,36 @@ int function (const char *fmt, ...) {
 	va_end(ap);
 }
 @endcode
+<h1 class="pg">Rate-limited logging</h1>
+Each simplified macro has _ONCE, _EVERY_N and _EVERY_MS variants for logging from hot paths.
+The state is kept per call site. Suppressed calls are not formatted, and the next message from the call site ends with "(suppressed N)".
+
+@code
+#define LOG_TAG "YOUR_APP"
+#include <dlog.h>
+
+void on_frame(int frame) {
+	LOGD_ONCE("first frame %d \n", frame);
+	LOGI_EVERY_N(100, "frame %d \n", frame);
+	LOGW_EVERY_MS(1000, "frame %d late \n", frame);
+}
+@endcode
+<h1 class="pg">Removing low priority logs at build time</h1>
+Simplified macros below the build-time priority floor are compiled out, and their arguments are not evaluated.
+The floor of a whole build is set with DLOG_MIN_PRIORITY, usually from a generated header passed as DLOG_PRIORITY_HEADER.
+dlog configured with --with-min-priority=<priority> passes it to every package built against it, through dlog.pc.
+A module can override it by defining LOG_MIN_PRIORITY together with its LOG_TAG.
+
+@code
+#define LOG_TAG "YOUR_APP"
+#define LOG_MIN_PRIORITY DLOG_INFO
+#include <dlog.h>
+
+int function () {
+	LOGD("not compiled in: %d\n", expensive_call());
+	LOGI("information message from YOUR_APP \n");
+}
+@endcode
 <h1 class="pg">dlogutil</h1>
 	<h2 class="pg">Introduction</h2>
 You can use dlogutil command to view and follow the contents of the log buffers. The general usage is :
@@ -140,7 +170,7 @@ if you want to see all log message above of info priority also,
 </tr>
 <tr>
 	<td>-b <buffer> </td>
-	<td>Alternate log buffer. The main buffer is used by default buffer. </td>
+	<td>Alternate log buffer. The main buffer is used by default buffer. <buffer> can also be a source of log entries other than a log device: "-" reads them from stdin, "stream:<filename>" from a file or FIFO, "unix:<socket>" from a unix socket, and "capture:<filename>" from a binary capture written with -B or -S. Their entries are merged with those of the buffers, and dlogutil ends when all of them have ended.</td>
 </tr>
 <tr>
 	<td>-c</td>
@@ -160,7 +190,15 @@ if you want to see all log message above of info priority also,
 </tr>
 <tr>
 	<td>-n <count></td>
-	<td>Sets the maximum number of rotated logs to <count>. The default value is 4. Requires the -r option</td>
+	<td>Keeps rotated logs up to <count> times the -r size in total. Rotated logs are named <filename>.<generation>.<date>-<time>, with the suffix of the codec the build was configured with: .gz by default, .zst with --with-compression=zstd, and none with --with-compression=no. Rotated -B and -S captures are not compressed and have no suffix. The default value is 4. Requires the -r option</td>
+</tr>
+<tr>
+	<td>-m <Kbytes></td>
+	<td>Keeps the log in a circular file of <Kbytes> instead of rotating it. The file is allocated at its full size, and the oldest lines are overwritten when it is full. Requires the -f option, and can't be used with -r.</td>
+</tr>
+<tr>
+	<td>-M <filename></td>
+	<td>Prints a circular log file written with -m, oldest line first, and exits.</td>
 </tr>
 <tr>
 	<td>-r <Kbytes></td>
@@ -174,6 +212,66 @@ if you want to see all log message above of info priority also,
 	<td>-v <format></td>
 	<td>Sets the output format for log messages. The default is brief format. </td>
 </tr>
+<tr>
+	<td>-B</td>
+	<td>Writes a binary capture of the log entries instead of formatted lines. Entries keep their exact timestamps, pid and tid, and can be printed later with -F. Rotated files are not compressed, so that -F can read them.</td>
+</tr>
+<tr>
+	<td>-F <filename></td>
+	<td>Prints a binary capture written with -B or -S, in the format given with -v and with the given filters, and exits. Its rotated files are printed first. The files are mapped rather than read, and formatted on all CPUs unless -j says otherwise.</td>
+</tr>
+<tr>
+	<td>-S</td>
+	<td>Like -B, and ends every file with an index of its timestamps, tags and pids, so that -F can answer queries without reading all of it. Requires the -f option.</td>
+</tr>
+<tr>
+	<td>--since <time>, --until <time></td>
+	<td>With -F, prints only the entries from <time> on, or up to <time>. <time> is [YYYY-]MM-DD HH:MM:SS[.fff] in local time, or @<seconds since Epoch>.</td>
+</tr>
+<tr>
+	<td>--tag <tag>, --pid <pid></td>
+	<td>With -F, prints only the entries of <tag>, or of <pid>.</td>
+</tr>
+<tr>
+	<td>-l <msec></td>
+	<td>Collects log entries for <msec> after each wakeup, so that they are printed in larger batches. The default value is 0.</td>
+</tr>
+<tr>
+	<td>-j <threads></td>
+	<td>Formats log lines on <threads> threads, and writes them on another, in the same order. Can't be used with -B or -S. The default value is 0, which reads, formats and writes on one thread, or with -F the number of CPUs.</td>
+</tr>
+<tr>
+	<td>-q <Kbytes></td>
+	<td>Keeps at most <Kbytes> of log entries queued while the output falls behind, so that dlogutil stays within a fixed amount of memory. Past it, entries are dropped by the --drop policy, and a "dropped N records" line takes their place. There is no limit by default.</td>
+</tr>
+<tr>
+	<td>--drop <policy></td>
+	<td>With -q, what to do past the limit: "priority" drops the lowest priority entries first, and is the default; "oldest" drops the oldest entries; "pause" stops reading until the output catches up, and the entries the log device overwrites meanwhile are reported as lost.</td>
+</tr>
+<tr>
+	<td>-u <msec></td>
+	<td>Prints a line that the same pid repeats within <msec> only once. The repeats are counted, and a "last message from pid N repeated N times over T ms" line follows once the pid logs something else or the <msec> are over. Lines filtered out don't count. Can't be used with -B or -S.</td>
+</tr>
+<tr>
+	<td>--sink <options></td>
+	<td>Writes the log to one more sink, besides the one the other options describe. <options> are the -b, -f, -r, -n, -m, -v and -s options and filterspecs of the sink, separated by spaces, for example --sink "-b radio -f /var/log/radio -r 1024 *:V". A sink without -b takes the buffers the other options do. Every entry is read and parsed once, however many sinks print it. Up to 7 --sink options can be given.</td>
+</tr>
+<tr>
+	<td>-C <file></td>
+	<td>Writes the log to the sinks of <file> instead of the one the other options describe. Every line of <file> is a sink, given like the <options> of --sink, and lines starting with # are skipped. On SIGHUP, <file> is read again and its sinks replace the running ones between two entries; a sink writing where a running one does keeps its file open, so no line is lost or written twice. If <file> has errors, they are printed and the running sinks are kept. Can't be used with -f, -r, -n, -m, -v, -s, -B, -S, --sink or filterspecs.</td>
+</tr>
+<tr>
+	<td>--io <engine></td>
+	<td>How log files are written: "sync" writes them with write() on the thread that formats or reads the log, and is the default; "uring" queues the writes to io_uring, up to 4 buffers of them at a time, and rotates files behind the writes in flight, so that slow storage holds up reading only once all 4 are. Outputs other than files, kernels without io_uring (before Linux 5.6) and builds configured with --disable-io-uring write with "sync".</td>
+</tr>
+<tr>
+	<td>--window <Kbytes></td>
+	<td>Keeps the last <Kbytes> of log entries in memory instead of writing them, and writes them only when a trigger comes: an entry matching the filterspecs given with --trigger, "*:E" by default, an entry with the text given with --match in its message, or SIGUSR1. A "--- trigger: ... ---" line goes first, then the entries kept, then everything up to --post <msec> after the trigger, 5000 by default. The entries are kept as binary capture records, and the filters and format of the sinks apply only when they are written, so that with "*:V" all of them are.</td>
+</tr>
+<tr>
+	<td>-w <msec></td>
+	<td>Waits up to <msec> for late entries of other buffers before printing, so that entries of several buffers come out in time order. The default value is 20.</td>
+</tr>
 
 </table>
 
@@ -87,6 +87,40 @@ typedef enum {
 
 #define CONDITION(cond)     (__builtin_expect((cond)!=0, 0))
 
+/*
+ * Build-time priority floor.
+ *
+ * DLOG_MIN_PRIORITY is the lowest priority kept by the simplified macros
+ * (LOGD, SLOGI_IF, ...) for a whole build. It is normally provided by a
+ * header generated from the build configuration; pass its name with
+ * -DDLOG_PRIORITY_HEADER='"dlog_priority.h"' and it is included here.
+ * dlog itself can be configured with --with-min-priority, and its dlog.pc
+ * then passes -DDLOG_MIN_PRIORITY to everything built against it.
+ * A module may override the floor by defining LOG_MIN_PRIORITY before
+ * including dlog.h, next to its LOG_TAG:
+ *
+ *  #define LOG_TAG "CAMERA"
+ *  #define LOG_MIN_PRIORITY DLOG_INFO
+ *  #include <dlog.h>
+ *
+ * Macros below the floor expand to a constant-false conditional, so the
+ * call is dropped by the compiler and neither the condition nor the
+ * arguments are evaluated.
+ */
+#ifdef DLOG_PRIORITY_HEADER
+#include DLOG_PRIORITY_HEADER
+#endif
+
+#ifndef DLOG_MIN_PRIORITY
+#define DLOG_MIN_PRIORITY DLOG_VERBOSE
+#endif
+
+#ifndef LOG_MIN_PRIORITY
+#define LOG_MIN_PRIORITY DLOG_MIN_PRIORITY
+#endif
+
+#define LOG_PRI_ENABLED(priority)	((D##priority) >= (LOG_MIN_PRIORITY))
+
 // ---------------------------------------------------------------------
 
 /**
@@ -96,7 +130,10 @@ typedef enum {
 #if LOG_NDEBUG
 #define LOGV(...)   ((void)0)
 #else
-#define LOGV(...) ((void)LOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__))
+#define LOGV(...) \
+    (LOG_PRI_ENABLED(LOG_VERBOSE) \
+    ? ((void)LOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 
 #endif
 #endif
@@ -109,7 +146,7 @@ typedef enum {
 #define LOGV_IF(cond, ...)   ((void)0)
 #else
 #define LOGV_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_VERBOSE) && CONDITION(cond)) \
     ? ((void)LOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -119,7 +156,10 @@ typedef enum {
  * Simplified macro to send a debug log message using the current LOG_TAG.
  */
 #ifndef LOGD
-#define LOGD(...) ((void)LOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__))
+#define LOGD(...) \
+    (LOG_PRI_ENABLED(LOG_DEBUG) \
+    ? ((void)LOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -127,7 +167,7 @@ typedef enum {
  */
 #ifndef LOGD_IF
 #define LOGD_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_DEBUG) && CONDITION(cond)) \
     ? ((void)LOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -136,7 +176,10 @@ typedef enum {
  * Simplified macro to send an info log message using the current LOG_TAG.
  */
 #ifndef LOGI
-#define LOGI(...) ((void)LOG(LOG_INFO, LOG_TAG, __VA_ARGS__))
+#define LOGI(...) \
+    (LOG_PRI_ENABLED(LOG_INFO) \
+    ? ((void)LOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -144,7 +187,7 @@ typedef enum {
  */
 #ifndef LOGI_IF
 #define LOGI_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_INFO) && CONDITION(cond)) \
     ? ((void)LOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -153,7 +196,10 @@ typedef enum {
  * Simplified macro to send a warning log message using the current LOG_TAG.
  */
 #ifndef LOGW
-#define LOGW(...) ((void)LOG(LOG_WARN, LOG_TAG, __VA_ARGS__))
+#define LOGW(...) \
+    (LOG_PRI_ENABLED(LOG_WARN) \
+    ? ((void)LOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -161,7 +207,7 @@ typedef enum {
  */
 #ifndef LOGW_IF
 #define LOGW_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_WARN) && CONDITION(cond)) \
     ? ((void)LOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -170,7 +216,10 @@ typedef enum {
  * Simplified macro to send an error log message using the current LOG_TAG.
  */
 #ifndef LOGE
-#define LOGE(...) ((void)LOG(LOG_ERROR, LOG_TAG, __VA_ARGS__))
+#define LOGE(...) \
+    (LOG_PRI_ENABLED(LOG_ERROR) \
+    ? ((void)LOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -178,7 +227,7 @@ typedef enum {
  */
 #ifndef LOGE_IF
 #define LOGE_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_ERROR) && CONDITION(cond)) \
     ? ((void)LOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -192,7 +241,10 @@ typedef enum {
 #if LOG_NDEBUG
 #define RLOGV(...)   ((void)0)
 #else
-#define RLOGV(...) ((void)RLOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__))
+#define RLOGV(...) \
+    (LOG_PRI_ENABLED(LOG_VERBOSE) \
+    ? ((void)RLOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 #endif
 	
@@ -204,7 +256,7 @@ typedef enum {
 #define RLOGV_IF(cond, ...)   ((void)0)
 #else
 #define RLOGV_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_VERBOSE) && CONDITION(cond)) \
 		? ((void)RLOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -214,7 +266,10 @@ typedef enum {
  * Simplified macro to send a debug radio log message using the current LOG_TAG.
  */
 #ifndef RLOGD
-#define RLOGD(...) ((void)RLOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__))
+#define RLOGD(...) \
+    (LOG_PRI_ENABLED(LOG_DEBUG) \
+    ? ((void)RLOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -222,7 +277,7 @@ typedef enum {
  */	
 #ifndef RLOGD_IF
 #define RLOGD_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_DEBUG) && CONDITION(cond)) \
 		? ((void)RLOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -231,7 +286,10 @@ typedef enum {
  * Simplified macro to send an info radio log message using the current LOG_TAG.
  */
 #ifndef RLOGI
-#define RLOGI(...) ((void)RLOG(LOG_INFO, LOG_TAG, __VA_ARGS__))
+#define RLOGI(...) \
+    (LOG_PRI_ENABLED(LOG_INFO) \
+    ? ((void)RLOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -239,7 +297,7 @@ typedef enum {
  */
 #ifndef RLOGI_IF
 #define RLOGI_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_INFO) && CONDITION(cond)) \
 		? ((void)RLOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -248,7 +306,10 @@ typedef enum {
  * Simplified macro to send a warning radio log message using the current LOG_TAG.
  */
 #ifndef RLOGW
-#define RLOGW(...) ((void)RLOG(LOG_WARN, LOG_TAG, __VA_ARGS__))
+#define RLOGW(...) \
+    (LOG_PRI_ENABLED(LOG_WARN) \
+    ? ((void)RLOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -256,7 +317,7 @@ typedef enum {
  */
 #ifndef RLOGW_IF
 #define RLOGW_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_WARN) && CONDITION(cond)) \
 		? ((void)RLOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -265,7 +326,10 @@ typedef enum {
  * Simplified macro to send an error radio log message using the current LOG_TAG.
  */
 #ifndef RLOGE
-#define RLOGE(...) ((void)RLOG(LOG_ERROR, LOG_TAG, __VA_ARGS__))
+#define RLOGE(...) \
+    (LOG_PRI_ENABLED(LOG_ERROR) \
+    ? ((void)RLOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -273,7 +337,7 @@ typedef enum {
  */	
 #ifndef RLOGE_IF
 #define RLOGE_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_ERROR) && CONDITION(cond)) \
 		? ((void)RLOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -287,7 +351,10 @@ typedef enum {
 #if LOG_NDEBUG
 #define SLOGV(...)   ((void)0)
 #else
-#define SLOGV(...) ((void)SLOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__))
+#define SLOGV(...) \
+    (LOG_PRI_ENABLED(LOG_VERBOSE) \
+    ? ((void)SLOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 #endif
 
@@ -299,7 +366,7 @@ typedef enum {
 #define SLOGV_IF(cond, ...)   ((void)0)
 #else
 #define SLOGV_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_VERBOSE) && CONDITION(cond)) \
 		? ((void)SLOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -309,7 +376,10 @@ typedef enum {
  * Simplified macro to send a debug system log message using the current LOG_TAG.
  */
 #ifndef SLOGD
-#define SLOGD(...) ((void)SLOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__))
+#define SLOGD(...) \
+    (LOG_PRI_ENABLED(LOG_DEBUG) \
+    ? ((void)SLOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -317,7 +387,7 @@ typedef enum {
  */
 #ifndef SLOGD_IF
 #define SLOGD_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_DEBUG) && CONDITION(cond)) \
 		? ((void)SLOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -326,7 +396,10 @@ typedef enum {
  * Simplified macro to send an info system log message using the current LOG_TAG.
  */
 #ifndef SLOGI
-#define SLOGI(...) ((void)SLOG(LOG_INFO, LOG_TAG, __VA_ARGS__))
+#define SLOGI(...) \
+    (LOG_PRI_ENABLED(LOG_INFO) \
+    ? ((void)SLOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -334,7 +407,7 @@ typedef enum {
  */
 #ifndef SLOGI_IF
 #define SLOGI_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_INFO) && CONDITION(cond)) \
 		? ((void)SLOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -343,7 +416,10 @@ typedef enum {
  * Simplified macro to send a warning system log message using the current LOG_TAG.
  */
 #ifndef SLOGW
-#define SLOGW(...) ((void)SLOG(LOG_WARN, LOG_TAG, __VA_ARGS__))
+#define SLOGW(...) \
+    (LOG_PRI_ENABLED(LOG_WARN) \
+    ? ((void)SLOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -351,7 +427,7 @@ typedef enum {
  */
 #ifndef SLOGW_IF
 #define SLOGW_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_WARN) && CONDITION(cond)) \
 		? ((void)SLOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -360,7 +436,10 @@ typedef enum {
  * Simplified macro to send an error system log message using the current LOG_TAG.
  */
 #ifndef SLOGE
-#define SLOGE(...) ((void)SLOG(LOG_ERROR, LOG_TAG, __VA_ARGS__))
+#define SLOGE(...) \
+    (LOG_PRI_ENABLED(LOG_ERROR) \
+    ? ((void)SLOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -368,7 +447,7 @@ typedef enum {
  */
 #ifndef SLOGE_IF
 #define SLOGE_IF(cond, ...) \
-		( (CONDITION(cond)) \
+		( (LOG_PRI_ENABLED(LOG_ERROR) && CONDITION(cond)) \
 		? ((void)SLOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
 		: (void)0 )
 #endif
@@ -382,7 +461,10 @@ typedef enum {
 #if LOG_NDEBUG
 #define ALOGV(...)   ((void)0)
 #else
-#define ALOGV(...) ((void)ALOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__))
+#define ALOGV(...) \
+    (LOG_PRI_ENABLED(LOG_VERBOSE) \
+    ? ((void)ALOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 
 #endif
 #endif
@@ -395,7 +477,7 @@ typedef enum {
 #define ALOGV_IF(cond, ...)   ((void)0)
 #else
 #define ALOGV_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_VERBOSE) && CONDITION(cond)) \
     ? ((void)ALOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -405,7 +487,10 @@ typedef enum {
  * Simplified macro to send a debug log message using the current LOG_TAG.
  */
 #ifndef ALOGD
-#define ALOGD(...) ((void)ALOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__))
+#define ALOGD(...) \
+    (LOG_PRI_ENABLED(LOG_DEBUG) \
+    ? ((void)ALOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -413,7 +498,7 @@ typedef enum {
  */
 #ifndef ALOGD_IF
 #define ALOGD_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_DEBUG) && CONDITION(cond)) \
     ? ((void)ALOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -422,7 +507,10 @@ typedef enum {
  * Simplified macro to send an info log message using the current LOG_TAG.
  */
 #ifndef ALOGI
-#define ALOGI(...) ((void)ALOG(LOG_INFO, LOG_TAG, __VA_ARGS__))
+#define ALOGI(...) \
+    (LOG_PRI_ENABLED(LOG_INFO) \
+    ? ((void)ALOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -430,7 +518,7 @@ typedef enum {
  */
 #ifndef ALOGI_IF
 #define ALOGI_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_INFO) && CONDITION(cond)) \
     ? ((void)ALOG(LOG_INFO, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -439,7 +527,10 @@ typedef enum {
  * Simplified macro to send a warning log message using the current LOG_TAG.
  */
 #ifndef ALOGW
-#define ALOGW(...) ((void)ALOG(LOG_WARN, LOG_TAG, __VA_ARGS__))
+#define ALOGW(...) \
+    (LOG_PRI_ENABLED(LOG_WARN) \
+    ? ((void)ALOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -447,7 +538,7 @@ typedef enum {
  */
 #ifndef ALOGW_IF
 #define ALOGW_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_WARN) && CONDITION(cond)) \
     ? ((void)ALOG(LOG_WARN, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -456,7 +547,10 @@ typedef enum {
  * Simplified macro to send an error log message using the current LOG_TAG.
  */
 #ifndef ALOGE
-#define ALOGE(...) ((void)ALOG(LOG_ERROR, LOG_TAG, __VA_ARGS__))
+#define ALOGE(...) \
+    (LOG_PRI_ENABLED(LOG_ERROR) \
+    ? ((void)ALOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
+    : (void)0 )
 #endif
 
 /**
@@ -464,7 +558,7 @@ typedef enum {
  */
 #ifndef ALOGE_IF
 #define ALOGE_IF(cond, ...) \
-    ( (CONDITION(cond)) \
+    ( (LOG_PRI_ENABLED(LOG_ERROR) && CONDITION(cond)) \
     ? ((void)ALOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)) \
     : (void)0 )
 #endif
@@ -472,6 +566,350 @@ typedef enum {
 
 // ---------------------------------------------------------------------
 
+/**
+ * Rate-limited variants of the simplified macros.
+ *
+ * XLOGx_ONCE(...) logs only the first time the call site is reached,
+ * XLOGx_EVERY_N(n, ...) logs every n-th time, starting with the first, and
+ * XLOGx_EVERY_MS(ms, ...) logs at most once every ms milliseconds.
+ * An n or ms of 0 is the same as XLOGx_ONCE.
+ * The state is kept per call site and is thread safe. Suppressed calls
+ * do not format their message; the next message logged from the site
+ * ends with "(suppressed N)".
+ *
+ * Example:
+ *  while (poll_device(dev) < 0)
+ *      LOGW_EVERY_MS(1000, "device %s not ready", dev->name);
+ */
+
+/**
+ * Rate-limited log messages using the current LOG_TAG.
+ */
+#ifndef LOGV_ONCE
+#if LOG_NDEBUG
+#define LOGV_ONCE(...)   ((void)0)
+#else
+#define LOGV_ONCE(...) \
+	print_limited_log(LOG_VERBOSE, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef LOGV_EVERY_N
+#if LOG_NDEBUG
+#define LOGV_EVERY_N(n, ...)   ((void)0)
+#else
+#define LOGV_EVERY_N(n, ...) \
+	print_limited_log(LOG_VERBOSE, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef LOGV_EVERY_MS
+#if LOG_NDEBUG
+#define LOGV_EVERY_MS(ms, ...)   ((void)0)
+#else
+#define LOGV_EVERY_MS(ms, ...) \
+	print_limited_log(LOG_VERBOSE, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+#endif
+
+#ifndef LOGD_ONCE
+#define LOGD_ONCE(...) \
+	print_limited_log(LOG_DEBUG, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef LOGD_EVERY_N
+#define LOGD_EVERY_N(n, ...) \
+	print_limited_log(LOG_DEBUG, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef LOGD_EVERY_MS
+#define LOGD_EVERY_MS(ms, ...) \
+	print_limited_log(LOG_DEBUG, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef LOGI_ONCE
+#define LOGI_ONCE(...) \
+	print_limited_log(LOG_INFO, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef LOGI_EVERY_N
+#define LOGI_EVERY_N(n, ...) \
+	print_limited_log(LOG_INFO, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef LOGI_EVERY_MS
+#define LOGI_EVERY_MS(ms, ...) \
+	print_limited_log(LOG_INFO, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef LOGW_ONCE
+#define LOGW_ONCE(...) \
+	print_limited_log(LOG_WARN, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef LOGW_EVERY_N
+#define LOGW_EVERY_N(n, ...) \
+	print_limited_log(LOG_WARN, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef LOGW_EVERY_MS
+#define LOGW_EVERY_MS(ms, ...) \
+	print_limited_log(LOG_WARN, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef LOGE_ONCE
+#define LOGE_ONCE(...) \
+	print_limited_log(LOG_ERROR, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef LOGE_EVERY_N
+#define LOGE_EVERY_N(n, ...) \
+	print_limited_log(LOG_ERROR, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef LOGE_EVERY_MS
+#define LOGE_EVERY_MS(ms, ...) \
+	print_limited_log(LOG_ERROR, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+// ---------------------------------------------------------------------
+
+/**
+ * Rate-limited radio log messages using the current LOG_TAG.
+ */
+#ifndef RLOGV_ONCE
+#if LOG_NDEBUG
+#define RLOGV_ONCE(...)   ((void)0)
+#else
+#define RLOGV_ONCE(...) \
+	print_limited_radio_log(LOG_VERBOSE, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef RLOGV_EVERY_N
+#if LOG_NDEBUG
+#define RLOGV_EVERY_N(n, ...)   ((void)0)
+#else
+#define RLOGV_EVERY_N(n, ...) \
+	print_limited_radio_log(LOG_VERBOSE, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef RLOGV_EVERY_MS
+#if LOG_NDEBUG
+#define RLOGV_EVERY_MS(ms, ...)   ((void)0)
+#else
+#define RLOGV_EVERY_MS(ms, ...) \
+	print_limited_radio_log(LOG_VERBOSE, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+#endif
+
+#ifndef RLOGD_ONCE
+#define RLOGD_ONCE(...) \
+	print_limited_radio_log(LOG_DEBUG, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGD_EVERY_N
+#define RLOGD_EVERY_N(n, ...) \
+	print_limited_radio_log(LOG_DEBUG, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGD_EVERY_MS
+#define RLOGD_EVERY_MS(ms, ...) \
+	print_limited_radio_log(LOG_DEBUG, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef RLOGI_ONCE
+#define RLOGI_ONCE(...) \
+	print_limited_radio_log(LOG_INFO, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGI_EVERY_N
+#define RLOGI_EVERY_N(n, ...) \
+	print_limited_radio_log(LOG_INFO, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGI_EVERY_MS
+#define RLOGI_EVERY_MS(ms, ...) \
+	print_limited_radio_log(LOG_INFO, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef RLOGW_ONCE
+#define RLOGW_ONCE(...) \
+	print_limited_radio_log(LOG_WARN, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGW_EVERY_N
+#define RLOGW_EVERY_N(n, ...) \
+	print_limited_radio_log(LOG_WARN, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGW_EVERY_MS
+#define RLOGW_EVERY_MS(ms, ...) \
+	print_limited_radio_log(LOG_WARN, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef RLOGE_ONCE
+#define RLOGE_ONCE(...) \
+	print_limited_radio_log(LOG_ERROR, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGE_EVERY_N
+#define RLOGE_EVERY_N(n, ...) \
+	print_limited_radio_log(LOG_ERROR, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef RLOGE_EVERY_MS
+#define RLOGE_EVERY_MS(ms, ...) \
+	print_limited_radio_log(LOG_ERROR, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+// ---------------------------------------------------------------------
+
+/**
+ * Rate-limited system log messages using the current LOG_TAG.
+ */
+#ifndef SLOGV_ONCE
+#if LOG_NDEBUG
+#define SLOGV_ONCE(...)   ((void)0)
+#else
+#define SLOGV_ONCE(...) \
+	print_limited_system_log(LOG_VERBOSE, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef SLOGV_EVERY_N
+#if LOG_NDEBUG
+#define SLOGV_EVERY_N(n, ...)   ((void)0)
+#else
+#define SLOGV_EVERY_N(n, ...) \
+	print_limited_system_log(LOG_VERBOSE, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef SLOGV_EVERY_MS
+#if LOG_NDEBUG
+#define SLOGV_EVERY_MS(ms, ...)   ((void)0)
+#else
+#define SLOGV_EVERY_MS(ms, ...) \
+	print_limited_system_log(LOG_VERBOSE, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+#endif
+
+#ifndef SLOGD_ONCE
+#define SLOGD_ONCE(...) \
+	print_limited_system_log(LOG_DEBUG, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGD_EVERY_N
+#define SLOGD_EVERY_N(n, ...) \
+	print_limited_system_log(LOG_DEBUG, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGD_EVERY_MS
+#define SLOGD_EVERY_MS(ms, ...) \
+	print_limited_system_log(LOG_DEBUG, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef SLOGI_ONCE
+#define SLOGI_ONCE(...) \
+	print_limited_system_log(LOG_INFO, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGI_EVERY_N
+#define SLOGI_EVERY_N(n, ...) \
+	print_limited_system_log(LOG_INFO, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGI_EVERY_MS
+#define SLOGI_EVERY_MS(ms, ...) \
+	print_limited_system_log(LOG_INFO, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef SLOGW_ONCE
+#define SLOGW_ONCE(...) \
+	print_limited_system_log(LOG_WARN, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGW_EVERY_N
+#define SLOGW_EVERY_N(n, ...) \
+	print_limited_system_log(LOG_WARN, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGW_EVERY_MS
+#define SLOGW_EVERY_MS(ms, ...) \
+	print_limited_system_log(LOG_WARN, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef SLOGE_ONCE
+#define SLOGE_ONCE(...) \
+	print_limited_system_log(LOG_ERROR, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGE_EVERY_N
+#define SLOGE_EVERY_N(n, ...) \
+	print_limited_system_log(LOG_ERROR, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef SLOGE_EVERY_MS
+#define SLOGE_EVERY_MS(ms, ...) \
+	print_limited_system_log(LOG_ERROR, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+// ---------------------------------------------------------------------
+
+/**
+ * Rate-limited apps log messages using the current LOG_TAG.
+ */
+#ifndef ALOGV_ONCE
+#if LOG_NDEBUG
+#define ALOGV_ONCE(...)   ((void)0)
+#else
+#define ALOGV_ONCE(...) \
+	print_limited_apps_log(LOG_VERBOSE, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef ALOGV_EVERY_N
+#if LOG_NDEBUG
+#define ALOGV_EVERY_N(n, ...)   ((void)0)
+#else
+#define ALOGV_EVERY_N(n, ...) \
+	print_limited_apps_log(LOG_VERBOSE, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#endif
+#ifndef ALOGV_EVERY_MS
+#if LOG_NDEBUG
+#define ALOGV_EVERY_MS(ms, ...)   ((void)0)
+#else
+#define ALOGV_EVERY_MS(ms, ...) \
+	print_limited_apps_log(LOG_VERBOSE, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+#endif
+
+#ifndef ALOGD_ONCE
+#define ALOGD_ONCE(...) \
+	print_limited_apps_log(LOG_DEBUG, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGD_EVERY_N
+#define ALOGD_EVERY_N(n, ...) \
+	print_limited_apps_log(LOG_DEBUG, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGD_EVERY_MS
+#define ALOGD_EVERY_MS(ms, ...) \
+	print_limited_apps_log(LOG_DEBUG, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef ALOGI_ONCE
+#define ALOGI_ONCE(...) \
+	print_limited_apps_log(LOG_INFO, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGI_EVERY_N
+#define ALOGI_EVERY_N(n, ...) \
+	print_limited_apps_log(LOG_INFO, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGI_EVERY_MS
+#define ALOGI_EVERY_MS(ms, ...) \
+	print_limited_apps_log(LOG_INFO, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef ALOGW_ONCE
+#define ALOGW_ONCE(...) \
+	print_limited_apps_log(LOG_WARN, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGW_EVERY_N
+#define ALOGW_EVERY_N(n, ...) \
+	print_limited_apps_log(LOG_WARN, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGW_EVERY_MS
+#define ALOGW_EVERY_MS(ms, ...) \
+	print_limited_apps_log(LOG_WARN, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+#ifndef ALOGE_ONCE
+#define ALOGE_ONCE(...) \
+	print_limited_apps_log(LOG_ERROR, LOG_TAG, 0, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGE_EVERY_N
+#define ALOGE_EVERY_N(n, ...) \
+	print_limited_apps_log(LOG_ERROR, LOG_TAG, n, 0, __VA_ARGS__)
+#endif
+#ifndef ALOGE_EVERY_MS
+#define ALOGE_EVERY_MS(ms, ...) \
+	print_limited_apps_log(LOG_ERROR, LOG_TAG, 0, ms, __VA_ARGS__)
+#endif
+
+// ---------------------------------------------------------------------
+
 /**
  * Basic log message macro that allows you to specify a priority and a tag
  *
@@ -570,6 +1008,36 @@ typedef enum {
 #define vprint_system_log(prio, tag, fmt...) \
 	__dlog_vprint(LOG_ID_SYSTEM, prio, tag, fmt)
 
+#define print_limited_log(priority, tag, every_n, every_ms, fmt...) \
+	print_limited(LOG_ID_MAIN, priority, tag, every_n, every_ms, fmt)
+
+#define print_limited_radio_log(priority, tag, every_n, every_ms, fmt...) \
+	print_limited(LOG_ID_RADIO, priority, tag, every_n, every_ms, fmt)
+
+#define print_limited_system_log(priority, tag, every_n, every_ms, fmt...) \
+	print_limited(LOG_ID_SYSTEM, priority, tag, every_n, every_ms, fmt)
+
+#define print_limited_apps_log(priority, tag, every_n, every_ms, fmt...) \
+	print_limited(LOG_ID_APPS, priority, tag, every_n, every_ms, fmt)
+
+#define print_limited(log_id, priority, tag, every_n, every_ms, fmt...) \
+	do { \
+		static struct dlog_callsite __dlog_site; \
+		int __dlog_suppressed; \
+		if (LOG_PRI_ENABLED(priority) \
+		    && (__dlog_suppressed = __dlog_callsite_check(&__dlog_site, every_n, every_ms)) >= 0) \
+			__dlog_print_suppressed(log_id, D##priority, tag, __dlog_suppressed, fmt); \
+	} while (0)
+
+/**
+ * Per call site state of the rate-limited macros. Zero initialized.
+ */
+struct dlog_callsite {
+	unsigned int count;		/* times the call site was reached */
+	unsigned int suppressed;	/* calls skipped since the last message */
+	unsigned int last_ms;		/* monotonic time of the last message, 0 if none */
+};
+
 /**
  * @brief		send log. must specify log_id ,priority, tag and format string.
  * @pre		none
@@ -617,6 +1085,39 @@ int __dlog_print(log_id_t log_id, int prio, const char *tag, const char *fmt, ..
   */
 int __dlog_vprint(log_id_t log_id, int prio, const char *tag, const char *fmt, va_list ap);
 
+/**
+ * @brief		decide whether a rate-limited call site logs this time.
+ * @pre		none
+ * @post		none
+ * @see		__dlog_print_suppressed
+ * @remarks	you must not use this API directly. use LOGD_ONCE(), LOGW_EVERY_N(), LOGE_EVERY_MS() family instead.
+ * @param[in]	site	call site state, zero initialized
+ * @param[in]	every_n	log every n-th call (ignored when every_ms is set)
+ * @param[in]	every_ms	log at most once per every_ms milliseconds
+ * @return			Operation result
+ * @retval		0>=	Log now; number of calls suppressed since the last message
+ * @retval              -1	Suppress this call
+ * @remarks	with both every_n and every_ms 0 only the first call logs.
+ */
+int __dlog_callsite_check(struct dlog_callsite *site, unsigned int every_n, unsigned int every_ms);
+
+/**
+ * @brief		send log with a count of suppressed messages appended.
+ * @pre		none
+ * @post		none
+ * @see		__dlog_callsite_check
+ * @remarks	you must not use this API directly. use macros instead.
+ * @param[in]	log_id	log device id
+ * @param[in]	prio	priority
+ * @param[in]	tag	tag
+ * @param[in]	suppressed	number of suppressed messages, appended as " (suppressed N)" when not 0
+ * @param[in]	fmt	format string
+ * @return			Operation result
+ * @retval		0>=	Success
+ * @retval              -1	Error
+ */
+int __dlog_print_suppressed(log_id_t log_id, int prio, const char *tag, int suppressed, const char *fmt, ...);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGBINARY_H
+#define _LOGBINARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <logger.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary capture format of dlogutil -B. The file starts with
+ *
+ *	"DLOGBIN" <version byte> <count> { <length> <buffer name> } * count
+ *
+ * and each record that follows is
+ *
+ *	<buffer> <timestamp delta> <pid> <tid> <length> <payload>
+ *
+ * where every number is a LEB128 varint, the timestamp delta is the
+ * zigzag-encoded difference in nsec from the previous record, and the
+ * payload is the logger payload exactly as read from the device.
+ */
+#define LOG_BINARY_MAGIC	"DLOGBIN"
+#define LOG_BINARY_VERSION	1
+#define LOG_BINARY_MAX_BUFFERS	16
+
+/* a record can't be longer than its fields at their longest plus payload */
+#define LOG_BINARY_RECORD_MAX	(5 + 10 + 5 + 5 + 5 + LOGGER_ENTRY_MAX_PAYLOAD)
+
+struct log_binary_writer_t {
+	int64_t last_nsec;
+};
+
+struct log_binary_reader_t {
+	int fd;
+	const unsigned char* map;	/* the whole file when mapped, else NULL */
+	unsigned char buf[64 * 1024];
+	size_t pos;			/* in map or buf */
+	size_t len;
+	off_t buf_offset;	/* file offset of buf[0] */
+	off_t end;		/* where records stop, -1 at the end of the file */
+	int64_t last_nsec;
+	int buffer_count;
+	char* buffers[LOG_BINARY_MAX_BUFFERS];
+};
+
+/**
+ * Varints as used in captures. put writes at most 10 bytes; get returns
+ * the bytes used, or 0 if the varint runs past end.
+ */
+size_t log_binary_put_varint(char* buf, uint64_t value);
+size_t log_binary_get_varint(const unsigned char* p, const unsigned char* end, uint64_t* value);
+uint64_t log_binary_zigzag(int64_t value);
+int64_t log_binary_unzigzag(uint64_t value);
+
+/**
+ * Writes the file header naming count buffers into buf.
+ * Returns its length, or -1 if it doesn't fit in size.
+ */
+int log_binary_header(char* buf, size_t size, char* const* names, int count);
+
+/**
+ * Encodes entry, read from buffer number buffer, into buf, which must
+ * hold LOG_BINARY_RECORD_MAX bytes. Returns the record length.
+ */
+size_t log_binary_encode(struct log_binary_writer_t* writer, char* buf,
+		int buffer, const struct logger_entry* entry);
+
+/**
+ * Decodes the record at p, which must end before end, into entry.
+ * *last_nsec is the timestamp of the record before, and becomes that of
+ * this one. Returns the record length, or 0 if it is damaged.
+ */
+size_t log_binary_decode(const unsigned char* p, const unsigned char* end,
+		int64_t* last_nsec, int* buffer, struct logger_entry* entry);
+
+/**
+ * Reads the file header from fd. Returns -1 if fd is not a capture.
+ */
+int log_binary_open(struct log_binary_reader_t* reader, int fd);
+
+/**
+ * Reads the rest of the file through a read-only mapping instead of
+ * read(), once the header is read. Returns -1 if fd can't be mapped, and
+ * reading goes on as before.
+ */
+int log_binary_map(struct log_binary_reader_t* reader);
+
+/**
+ * Reads the next record into entry, which must hold
+ * LOGGER_ENTRY_MAX_LEN bytes. Returns 1 on success, 0 at the end of the
+ * file and -1 on a read error or a damaged record.
+ */
+int log_binary_read(struct log_binary_reader_t* reader, int* buffer,
+		struct logger_entry* entry);
+
+/**
+ * Continues reading at offset, where the record before had timestamp
+ * base_nsec. Returns -1 if fd can't seek.
+ */
+int log_binary_seek(struct log_binary_reader_t* reader, off_t offset, int64_t base_nsec);
+
+/**
+ * Returns the file offset of the next record.
+ */
+off_t log_binary_tell(const struct log_binary_reader_t* reader);
+
+void log_binary_close(struct log_binary_reader_t* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGBINARY_H*/
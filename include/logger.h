@@ -22,6 +22,20 @@ struct logger_entry {
     char        msg[0]; /* the entry's payload */
 };
 
+/*
+ * libdlog appends this trailer to the payload, after the terminating NUL
+ * of the message: <prio> <tag>\0 <message>\0 <trailer>. seq counts the
+ * records a thread wrote to one log id, so readers can detect records the
+ * ring dropped. magic is the last byte of the payload.
+ */
+struct logger_entry_seq {
+    uint32_t    seq;    /* per thread, per log id sequence number */
+    uint8_t     log_id; /* log id the record was written with */
+    uint8_t     magic;  /* LOGGER_SEQ_MAGIC */
+} __attribute__((packed));
+
+#define LOGGER_SEQ_MAGIC	0xd5
+
 #define LOGGER_LOG_MAIN		"log_main"
 #define LOGGER_LOG_RADIO	"log_radio"
 #define LOGGER_LOG_SYSTEM	"log_system"
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGINDEX_H
+#define _LOGINDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <logger.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Index of a binary capture segment, appended to it when it is closed:
+ *
+ *	<min> <max> <tag count> { <length> <tag> } <pid count> { <pid> }
+ *	<block count> { <offset> <base> <min> <max> }
+ *	<index offset, 8 bytes little endian> "DLOGIDX" <version byte>
+ *
+ * A block covers about LOG_INDEX_BLOCK_SIZE bytes of records starting at
+ * offset; base is the timestamp the first record's delta is relative to,
+ * and min and max bound the timestamps in the block, which are not quite
+ * sorted. Numbers are varints, relative to the previous block where that
+ * makes them small.
+ */
+#define LOG_INDEX_MAGIC		"DLOGIDX"
+#define LOG_INDEX_VERSION	1
+#define LOG_INDEX_TRAILER_SIZE	16
+#define LOG_INDEX_BLOCK_SIZE	(64 * 1024)
+
+struct log_index_block_t {
+	off_t offset;
+	int64_t base_nsec;
+	int64_t min_nsec;
+	int64_t max_nsec;
+};
+
+struct log_index_t {
+	int64_t min_nsec;
+	int64_t max_nsec;
+	struct log_index_block_t* blocks;
+	size_t block_count;
+	size_t block_alloc;
+	char** tags;		/* open addressing, tag_size is a power of two */
+	size_t tag_count;
+	size_t tag_size;
+	uint32_t* pids;		/* pid + 1, 0 marks a free slot */
+	size_t pid_count;
+	size_t pid_size;
+};
+
+void log_index_init(struct log_index_t* idx);
+
+/**
+ * Empties idx for the next segment.
+ */
+void log_index_reset(struct log_index_t* idx);
+
+/**
+ * Records that entry is written at offset, right after a record with
+ * timestamp base_nsec. Returns -1 when out of memory.
+ */
+int log_index_add(struct log_index_t* idx, off_t offset, int64_t base_nsec,
+		const struct logger_entry* entry);
+
+/**
+ * Encodes idx, to be written at index_offset, into a malloc()ed buffer.
+ * Returns its length, or -1 when out of memory.
+ */
+int log_index_encode(const struct log_index_t* idx, off_t index_offset, char** buf);
+
+/**
+ * Loads the index at the end of the segment open at fd into idx, and
+ * stores where the records end in index_offset. Returns -1 if the
+ * segment has no index.
+ */
+int log_index_load(struct log_index_t* idx, int fd, off_t* index_offset);
+
+bool log_index_has_tag(const struct log_index_t* idx, const char* tag);
+bool log_index_has_pid(const struct log_index_t* idx, int32_t pid);
+
+void log_index_free(struct log_index_t* idx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGINDEX_H*/
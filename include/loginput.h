@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGINPUT_H
+#define _LOGINPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <logger.h>
+#include <logbinary.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Where dlogutil reads log entries from, as named after -b:
+ *
+ *	<buffer>		the log device /dev/log_<buffer>
+ *	-			framed entries on stdin
+ *	stream:<path>		framed entries in a file or FIFO
+ *	unix:<path>		framed entries from a Unix socket
+ *	capture:<path>		a binary capture written with -B or -S
+ *
+ * The driver returns one whole entry per read(). Everything else is a
+ * stream of entries as the driver returns them, a struct logger_entry
+ * followed by its payload, that may come in pieces or several at once.
+ */
+enum {
+	LOG_INPUT_DEVICE,
+	LOG_INPUT_STREAM,
+	LOG_INPUT_CAPTURE,
+};
+
+#define LOG_INPUT_BUF_SIZE	(64 * 1024)
+
+struct log_input_t {
+	int kind;
+	int fd;
+	bool pollable;		/* fd can be waited for with epoll */
+	unsigned char* buf;	/* streams: bytes read but not returned yet */
+	size_t pos;
+	size_t len;
+	struct log_binary_reader_t* capture;
+};
+
+/**
+ * Returns the path to open for spec, which the caller frees, or NULL when
+ * out of memory.
+ */
+char* log_input_name(const char* spec);
+
+/**
+ * Opens the source named by a log_input_name() result. A device is
+ * opened with flags; of the other sources, those that can be polled are
+ * made non-blocking if flags have O_NONBLOCK. Returns -1 on error.
+ */
+int log_input_open(struct log_input_t* in, const char* name, int flags);
+
+/**
+ * Reads the next entry into entry, which must hold LOGGER_ENTRY_MAX_LEN
+ * bytes. Returns the bytes of the entry, 0 at the end of the source, and
+ * -1 on error, with errno EAGAIN if nothing can be read yet.
+ */
+int log_input_read(struct log_input_t* in, struct logger_entry* entry);
+
+void log_input_close(struct log_input_t* in);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGINPUT_H*/
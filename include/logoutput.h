@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGOUTPUT_H
+#define _LOGOUTPUT_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include <logprint.h>
+#include <logring.h>
+#include <logrotate.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Output stage of dlogutil. Formatted lines are appended to one large
+ * buffer and written out when it fills up, when its oldest line is older
+ * than flush_msec, and before the file is closed or rotated. Interactive
+ * outputs flush after every batch of lines instead. With a ring set,
+ * flushing copies the lines into the ring file instead of writing to fd.
+ * Through io_uring, flushing hands the buffer to the kernel and goes on in
+ * another one, so that the reader only waits for storage once all
+ * LOG_OUTPUT_URING_DEPTH buffers are in flight.
+ */
+struct log_output_uring_t;
+
+struct log_output_t {
+	int fd;
+	char* buf;
+	size_t size;
+	size_t len;
+	int flush_msec;
+	bool interactive;
+	struct log_ring_t* ring;
+	struct timespec first;	/* when the oldest buffered line was added */
+	struct log_output_uring_t* uring;	/* NULL for synchronous writes */
+};
+
+#define LOG_OUTPUT_BUF_SIZE	(64 * 1024)
+#define LOG_OUTPUT_FLUSH_MSEC	1000
+#define LOG_OUTPUT_URING_DEPTH	4
+
+/**
+ * Sets up out to write to fd. Terminals are interactive.
+ * Returns -1 when out of memory.
+ */
+int log_output_init(struct log_output_t* out, int fd, size_t size, int flush_msec);
+
+/**
+ * Writes through io_uring from now on, which only regular files can.
+ * Returns -1 if io_uring can't be used, and out goes on writing
+ * synchronously.
+ */
+int log_output_use_uring(struct log_output_t* out);
+
+/**
+ * Appends len bytes. Returns len, or -1 on write error.
+ */
+int log_output_write(struct log_output_t* out, const char* data, size_t len);
+
+/**
+ * Formats entry straight into the buffer when it fits.
+ * Returns the number of bytes added, or -1 on error.
+ */
+int log_output_print_line(struct log_output_t* out, log_format* p_format, const log_entry* entry);
+
+/**
+ * Writes out everything buffered. Returns 0, or -1 on write error.
+ */
+int log_output_flush(struct log_output_t* out);
+
+/**
+ * Writes out everything buffered, and waits until the writes in flight are
+ * done. Returns 0, or -1 on write error.
+ */
+int log_output_sync(struct log_output_t* out);
+
+/**
+ * Syncs and frees the buffers. The file is left to the caller to close.
+ * Returns 0, or -1 on write error.
+ */
+int log_output_close(struct log_output_t* out);
+
+/**
+ * Through io_uring, rotates the output file: renames it to the next
+ * archive of rot and opens path again, empty, behind the writes in flight.
+ * The old file is closed and queued to rot once they are done. Returns -1
+ * on write error or when the file can't be opened.
+ */
+int log_output_rotate(struct log_output_t* out, const char* path, struct log_rotate_t* rot);
+
+/**
+ * Called when a batch of lines is done: flushes interactive outputs and
+ * outputs past their deadline. Returns 0, or -1 on write error.
+ */
+int log_output_batch_done(struct log_output_t* out);
+
+/**
+ * Returns msec until the buffered data must be flushed, or a rotation in
+ * flight needs looking after, -1 if there is none.
+ */
+int log_output_timeout(const struct log_output_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGOUTPUT_H*/
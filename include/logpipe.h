@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGPIPE_H
+#define _LOGPIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <logger.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Batches of entries passed between the stages of dlogutil -j: the reader
+ * fills them with copies of entries and marker lines, a formatter turns
+ * them into text, one text per output, and the writer writes the texts
+ * out.
+ */
+#define LOG_BATCH_SIZE		(64 * 1024)
+#define LOG_BATCH_MAX_TEXTS	8
+
+enum {
+	LOG_BATCH_ENTRY,	/* an entry to filter and format */
+	LOG_BATCH_TEXT,		/* entry.len bytes of text in entry.msg */
+};
+
+struct log_batch_record_t {
+	uint32_t kind;
+	uint32_t texts;			/* bit n set for each text n it goes to */
+	struct logger_entry entry;	/* must be last */
+};
+
+struct log_batch_text_t {
+	char* buf;
+	size_t len;
+	size_t size;
+};
+
+struct log_batch_t {
+	size_t used;
+	size_t count;
+	struct log_batch_text_t text[LOG_BATCH_MAX_TEXTS];
+	unsigned char records[LOG_BATCH_SIZE] __attribute__((aligned(4)));
+};
+
+/**
+ * Returns a new empty batch, or NULL when out of memory.
+ */
+struct log_batch_t* log_batch_new(void);
+
+/**
+ * Copies a record of kind with its payload into batch, for the texts set
+ * in the texts mask. Returns false if there is no room left.
+ */
+bool log_batch_add(struct log_batch_t* batch, uint32_t kind, uint32_t texts,
+		const struct logger_entry* entry);
+
+/**
+ * Returns the record at offset *pos and moves *pos past it, or NULL
+ * past the last record.
+ */
+struct log_batch_record_t* log_batch_next(struct log_batch_t* batch, size_t* pos);
+
+/**
+ * Makes room for len more bytes in text. Returns -1 when out of memory.
+ */
+int log_batch_reserve(struct log_batch_text_t* text, size_t len);
+
+void log_batch_reset(struct log_batch_t* batch);
+
+/*
+ * Bounded queue of batches. A NULL batch marks the end of the stream.
+ * With a wake fd, every push makes it readable, so that an epoll loop can
+ * wait for batches along with its devices.
+ */
+struct log_pipe_t {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct log_batch_t** slots;
+	size_t size;
+	size_t head;
+	size_t count;
+	int wake_fd;
+};
+
+/**
+ * Returns -1 when out of memory or eventfd fails.
+ */
+int log_pipe_init(struct log_pipe_t* pipe, size_t size, bool wake);
+
+/**
+ * Adds batch, waiting for room if the queue is full.
+ */
+void log_pipe_push(struct log_pipe_t* pipe, struct log_batch_t* batch);
+
+/**
+ * Takes the oldest batch, waiting up to timeout msec, or forever if
+ * timeout is -1. Returns false if none came.
+ */
+bool log_pipe_pop(struct log_pipe_t* pipe, struct log_batch_t** batch, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGPIPE_H*/
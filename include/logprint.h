@@ -50,6 +50,8 @@ typedef struct log_entry_t {
     const char * tag;
     size_t messageLen;
     const char * message;
+    int seq_log_id;         /* log id of the sequence trailer, -1 if none */
+    uint32_t seq;
 } log_entry;
 
 log_format *log_format_new();
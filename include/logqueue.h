@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGQUEUE_H
+#define _LOGQUEUE_H
+
+#include <stddef.h>
+
+#include <logger.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A record read from a log device, waiting to be merged and printed.
+ * Allocated from a log_arena with room for exactly its payload plus a
+ * terminating NUL.
+ */
+struct queued_entry_t {
+	struct queued_entry_t* next;
+	struct log_chunk_t* chunk;	/* arena chunk holding this entry */
+	unsigned int lost;		/* records lost before this one from the same writer */
+	struct logger_entry entry;	/* must be last, payload follows */
+};
+
+/*
+ * Queued entries are bump-allocated out of fixed-size chunks. A chunk is
+ * recycled as a whole once every entry in it has been freed, which is
+ * cheap because entries are freed in roughly the order they were read.
+ */
+struct log_arena_t {
+	struct log_chunk_t* current;	/* chunk new entries are carved from */
+	struct log_chunk_t* spare;	/* empty chunks kept for reuse */
+	int spare_count;
+	size_t chunk_count;		/* chunks allocated, including spares */
+	size_t live_entries;
+	size_t live_bytes;		/* bytes handed out to live entries */
+};
+
+#define LOG_ARENA_CHUNK_SIZE	(64 * 1024)
+#define LOG_ARENA_MAX_SPARE	4
+
+void log_arena_init(struct log_arena_t* arena);
+
+/**
+ * Returns an entry with room for a payload of payload_len bytes, or NULL
+ * when out of memory. next and lost are cleared.
+ */
+struct queued_entry_t* log_arena_alloc(struct log_arena_t* arena, size_t payload_len);
+
+/**
+ * Returns entry to its chunk. entry->entry.len must still be the
+ * payload_len it was allocated with.
+ */
+void log_arena_free(struct log_arena_t* arena, struct queued_entry_t* entry);
+
+/**
+ * Copies the wire-format record in buf into a new entry.
+ * Returns NULL when out of memory.
+ */
+struct queued_entry_t* log_arena_copy(struct log_arena_t* arena, const struct logger_entry* buf);
+
+/** returns the bytes the arena holds from the system */
+size_t log_arena_footprint(const struct log_arena_t* arena);
+
+/*
+ * Entries of one device, in the order they were read. The driver stamps
+ * records as they are written, so each queue is in timestamp order.
+ */
+struct log_queue_t {
+	struct queued_entry_t* head;
+	struct queued_entry_t* tail;
+	size_t count;
+	int heap_index;		/* position in the merge heap, -1 while empty */
+	int waited;		/* the merge waits for it while it is empty */
+	void* owner;
+};
+
+/*
+ * Min-heap of the non-empty queues, ordered by the timestamp of their
+ * head entry, merging k devices in O(log k) per entry.
+ */
+struct log_merge_t {
+	struct log_queue_t** heap;
+	int size;		/* non-empty queues */
+	int nqueues;		/* queues registered */
+	int idle;		/* empty queues that are waited for */
+};
+
+/**
+ * returns <0, 0 or >0 as a is older than, as old as or newer than b
+ */
+int log_entry_cmp(const struct logger_entry* a, const struct logger_entry* b);
+
+/**
+ * Registers an empty queue with the merge. Returns -1 when out of memory.
+ */
+int log_merge_add(struct log_merge_t* merge, struct log_queue_t* queue, void* owner);
+
+/**
+ * Sets whether queue can still deliver entries older than those of the
+ * other queues, which it is by default. One that can't, because its device
+ * ended or is read by no sink, no longer holds back the others while it is
+ * empty.
+ */
+void log_merge_wait(struct log_merge_t* merge, struct log_queue_t* queue, int waited);
+
+/** appends entry to queue */
+void log_merge_push(struct log_merge_t* merge, struct log_queue_t* queue, struct queued_entry_t* entry);
+
+/** returns the queue holding the oldest entry, or NULL if all are empty */
+struct log_queue_t* log_merge_first(const struct log_merge_t* merge);
+
+/** removes and returns the head entry of queue, which must not be empty */
+struct queued_entry_t* log_merge_pop(struct log_merge_t* merge, struct log_queue_t* queue);
+
+/**
+ * Removes and returns the entry after prev in queue, or its head entry if
+ * prev is NULL.
+ */
+struct queued_entry_t* log_merge_remove(struct log_merge_t* merge, struct log_queue_t* queue,
+		struct queued_entry_t* prev);
+
+/**
+ * Returns the queue whose head entry can be printed without breaking
+ * timestamp order, or NULL. That is the oldest entry when every waited for
+ * queue has something, since no queue can still produce an older one; otherwise only
+ * once the entry is at least as old as the watermark (sec, nsec), after
+ * which late records of the idle devices are no longer waited for.
+ */
+struct log_queue_t* log_merge_ready(const struct log_merge_t* merge, int32_t sec, int32_t nsec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGQUEUE_H*/
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGRING_H
+#define _LOGRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-size circular log file. The file is preallocated and mapped, a
+ * header page records where the oldest line starts and where the next one
+ * goes, and lines are copied in behind it, overwriting the oldest whole
+ * lines once the data area is full.
+ */
+#define LOG_RING_MAGIC		0x474e5244	/* "DRNG" */
+#define LOG_RING_VERSION	1
+#define LOG_RING_HEADER_SIZE	4096
+
+struct log_ring_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;		/* bytes of data following the header page */
+	uint64_t head;		/* offset of the oldest line */
+	uint64_t tail;		/* offset the next line is written to */
+	uint64_t generation;	/* times the data wrapped around */
+};
+
+struct log_ring_t {
+	int fd;
+	struct log_ring_header_t* header;
+	char* data;
+	size_t size;
+};
+
+/**
+ * Opens or creates the ring file at path with size bytes of data. An
+ * existing ring of the same size is appended to, anything else is
+ * started over. Returns -1 on error.
+ */
+int log_ring_open(struct log_ring_t* ring, const char* path, size_t size);
+
+/**
+ * Appends whole lines, dropping the oldest lines to make room.
+ */
+void log_ring_append(struct log_ring_t* ring, const char* data, size_t len);
+
+void log_ring_close(struct log_ring_t* ring);
+
+/**
+ * Writes the lines of the ring file at path to fd, oldest first.
+ * Returns -1 on error.
+ */
+int log_ring_print(const char* path, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGRING_H*/
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGROTATE_H
+#define _LOGROTATE_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Rotation of dlogutil's output file. The reader only renames the file it
+ * just closed to its archive name, <path>.<generation>.<YYYYmmdd-HHMMSS>;
+ * a worker thread compresses it and deletes the oldest archives once
+ * their compressed sizes add up to more than the budget.
+ */
+struct log_segment_t {
+	char* name;		/* archive name without the codec suffix */
+	unsigned int gen;
+	off_t size;		/* size on disk, once archived */
+	bool compressed;
+	struct log_segment_t* next;
+};
+
+struct log_rotate_t {
+	char* path;
+	off_t budget;		/* 0 means unbounded, owned by lock */
+	bool compress;
+	unsigned int gen;	/* generation of the next segment */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct log_segment_t* pending;		/* oldest first, owned by lock */
+	struct log_segment_t* archives;		/* oldest first, owned by the worker */
+	off_t archived_bytes;
+	bool stop;
+};
+
+#if defined(DLOG_COMPRESS_GZIP)
+#define LOG_ROTATE_SUFFIX	".gz"
+#elif defined(DLOG_COMPRESS_ZSTD)
+#define LOG_ROTATE_SUFFIX	".zst"
+#else
+#define LOG_ROTATE_SUFFIX	""
+#endif
+
+/**
+ * Starts the worker for path. Archives left by an earlier run are counted
+ * against budget, and the ones it did not get to compress are queued.
+ * Without compress, archives are only renamed and deleted, so they stay
+ * seekable. Returns -1 on error.
+ */
+int log_rotate_start(struct log_rotate_t* rot, const char* path, off_t budget, bool compress);
+
+/**
+ * Renames the closed output file to the next archive name and queues it.
+ * Returns -1 when the rename fails.
+ */
+int log_rotate_segment(struct log_rotate_t* rot);
+
+/**
+ * The two halves of log_rotate_segment(), for renaming the file some other
+ * way: returns the segment the file is to be renamed to, or NULL when out
+ * of memory, and queues it once renamed. Free an unused one with
+ * log_rotate_free_list().
+ */
+struct log_segment_t* log_rotate_next(struct log_rotate_t* rot);
+void log_rotate_queue(struct log_rotate_t* rot, struct log_segment_t* seg);
+
+/**
+ * Lists the archives of path, oldest first, for reading them back.
+ * Returns -1 if the directory can't be read.
+ */
+int log_rotate_list(const char* path, struct log_segment_t** list);
+void log_rotate_free_list(struct log_segment_t* list);
+
+/**
+ * Changes the budget, from the next archive on.
+ */
+void log_rotate_set_budget(struct log_rotate_t* rot, off_t budget);
+
+/**
+ * Waits until every queued segment is compressed, then stops the worker.
+ */
+void log_rotate_stop(struct log_rotate_t* rot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGROTATE_H*/
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGURING_H
+#define _LOGURING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Just enough of io_uring for dlogutil's output, on the raw system calls
+ * so that no library is needed. Requests are queued, handed to the kernel
+ * together by log_uring_submit(), and their results are reaped by the
+ * user_data they were queued with. Built with DLOG_IO_URING; without it,
+ * and on kernels older than 5.6 or where io_uring is disabled,
+ * log_uring_init() fails and the callers write synchronously.
+ */
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+struct log_uring_t {
+	int fd;
+	unsigned int* sq_head;
+	unsigned int* sq_tail;
+	unsigned int* sq_mask;
+	unsigned int* sq_array;
+	struct io_uring_sqe* sqes;
+	unsigned int* cq_head;
+	unsigned int* cq_tail;
+	unsigned int* cq_mask;
+	struct io_uring_cqe* cqes;
+	void* sq_map;
+	size_t sq_map_size;
+	void* cq_map;
+	size_t cq_map_size;
+	size_t sqes_size;
+	unsigned int entries;
+	unsigned int tail;	/* where the next request is queued */
+	bool file_ops;		/* close, rename and open can be queued */
+};
+
+/* the next request starts once this one is done, whatever its result */
+#define LOG_URING_LINK		1
+
+/**
+ * Sets up a ring for up to entries requests at a time.
+ * Returns -1 with errno set if io_uring can't be used.
+ */
+int log_uring_init(struct log_uring_t* ring, unsigned int entries);
+
+/**
+ * Registers the buffers fixed writes use, by their index in iov.
+ * Returns -1 on error, for instance over RLIMIT_MEMLOCK.
+ */
+int log_uring_register_buffers(struct log_uring_t* ring, const struct iovec* iov, int count);
+
+/**
+ * Queue requests. A write with buf_index >= 0 is from a registered buffer.
+ * Paths need only last until log_uring_submit(). Returns -1 with EBUSY
+ * when the submission queue is full.
+ */
+int log_uring_write(struct log_uring_t* ring, int fd, const void* buf, size_t len,
+		off_t offset, int buf_index, uint64_t user_data);
+int log_uring_close(struct log_uring_t* ring, int fd, uint64_t user_data);
+int log_uring_rename(struct log_uring_t* ring, const char* from, const char* to,
+		int flags, uint64_t user_data);
+int log_uring_open(struct log_uring_t* ring, const char* path, int flags, mode_t mode,
+		uint64_t user_data);
+
+/**
+ * Submits the queued requests. Returns -1 on error.
+ */
+int log_uring_submit(struct log_uring_t* ring);
+
+/**
+ * Takes the result of a finished request, waiting for one if wait is set.
+ * Returns 1 with its user_data and result, 0 if none is finished, or -1.
+ */
+int log_uring_reap(struct log_uring_t* ring, uint64_t* user_data, int* res, bool wait);
+
+void log_uring_free(struct log_uring_t* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGURING_H*/
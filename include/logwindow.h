@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGWINDOW_H
+#define _LOGWINDOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <logger.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The most recent log entries, kept in memory as binary capture records
+ * until something asks for them. Records are stored whole, one after the
+ * other; one that doesn't fit before the end of the buffer starts over at
+ * its beginning, and the oldest records make room for it.
+ */
+struct log_window_t {
+	char* buf;
+	size_t size;
+	size_t head;		/* offset of the oldest record */
+	size_t tail;		/* offset the next record is written to */
+	size_t wrap;		/* where the records before head end, once wrapped */
+	int wrapped;		/* tail has started over below head */
+	unsigned int count;
+};
+
+/**
+ * Sets up a window of size bytes, at least two records long.
+ * Returns -1 on error.
+ */
+int log_window_init(struct log_window_t* window, size_t size);
+
+/**
+ * Keeps entry, read from buffer, dropping the oldest entries to make room.
+ */
+void log_window_add(struct log_window_t* window, int buffer, const struct logger_entry* entry);
+
+/**
+ * Takes the oldest entry out. Returns 1, or 0 if the window is empty.
+ * entry must have room for LOGGER_ENTRY_MAX_PAYLOAD bytes of payload.
+ */
+int log_window_take(struct log_window_t* window, int* buffer, struct logger_entry* entry);
+
+void log_window_free(struct log_window_t* window);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_LOGWINDOW_H*/
@@ -19,12 +19,15 @@
 #endif
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <stdarg.h>
 #include <fcntl.h>
 #include <sys/uio.h>
 #include <stdio.h>
 #include <errno.h>
+#include <time.h>
 #include <dlog.h>
+#include <logger.h>
 
 #define LOG_BUF_SIZE	1024
 
@@ -33,11 +36,36 @@
 #define LOG_SYSTEM	"log_system"
 #define LOG_APPS	"log_apps"
 
+/*
+ * Load shedding. A writer that pushes more than SHED_DEBUG_PERCENT of a
+ * ring within one SHED_WINDOW_SEC window is about to overwrite records
+ * readers have not consumed yet, so its VERBOSE and DEBUG messages are
+ * dropped until its rate falls below SHED_RESUME_PERCENT. Above
+ * SHED_INFO_PERCENT INFO is dropped as well. WARN and above are never shed.
+ */
+#define SHED_WINDOW_SEC		1
+#define SHED_DEBUG_PERCENT	50
+#define SHED_INFO_PERCENT	100
+#define SHED_RESUME_PERCENT	25
+#define SHED_TAG		"DLOG"
+
+struct log_shed_t {
+	int ring_size;
+	time_t window;
+	int window_bytes;
+	int shed_pri;
+	unsigned int shed_count;
+};
 
 static int log_fds[(int)LOG_ID_MAX] = { -1, -1, -1, -1 };
 
 static int g_debug_level= DLOG_SILENT;
 
+static __thread uint32_t log_seq[(int)LOG_ID_MAX];
+
+static struct log_shed_t log_sheds[(int)LOG_ID_MAX];
+static struct log_shed_t *log_shed_of[(int)LOG_ID_MAX];
+
 static int __dlog_init(log_id_t, log_priority, const char *tag, const char *msg);
 static int (*write_to_log)(log_id_t, log_priority, const char *tag, const char *msg) = __dlog_init;
 #ifdef HAVE_PTHREADS
@@ -50,11 +78,84 @@ static int __write_to_log_null(log_id_t log_id, log_priority prio, const char *t
     return -1;
 }
 
+static int __write_to_log_kernel(log_id_t log_id, log_priority prio, const char *tag, const char *msg);
+
+/* returns the priority at or below which messages are being shed */
+static int shed_level(struct log_shed_t *shed, int bytes)
+{
+	if (bytes > shed->ring_size / 100 * SHED_INFO_PERCENT)
+		return DLOG_INFO;
+	if (bytes > shed->ring_size / 100 * SHED_DEBUG_PERCENT)
+		return DLOG_DEBUG;
+	if (shed->shed_pri && bytes >= shed->ring_size / 100 * SHED_RESUME_PERCENT)
+		return DLOG_DEBUG;
+	return 0;
+}
+
+static void shed_set_level(log_id_t log_id, struct log_shed_t *shed, int level)
+{
+	int old = shed->shed_pri;
+	unsigned int count;
+	char buf[128];
+
+	if (old == level || !__sync_bool_compare_and_swap(&shed->shed_pri, old, level))
+		return;
+
+	/* every change of level is logged, so the ring says what is missing */
+	if (level) {
+		snprintf(buf, sizeof(buf), "log ring overloaded by pid %d, dropping messages below %s",
+				getpid(), level == DLOG_INFO ? "WARN" : "INFO");
+		__write_to_log_kernel(log_id, DLOG_WARN, SHED_TAG, buf);
+	} else if (!level) {
+		count = __sync_lock_test_and_set(&shed->shed_count, 0);
+		snprintf(buf, sizeof(buf), "log ring load normal, pid %d dropped %u messages",
+				getpid(), count);
+		__write_to_log_kernel(log_id, DLOG_WARN, SHED_TAG, buf);
+	}
+}
+
+/*
+ * Accounts len bytes offered to the ring of log_id and returns 1 when
+ * the message should be dropped. The window bookkeeping is racy across
+ * threads on purpose; the rates it compares are approximate anyway.
+ */
+static int __dlog_should_shed(log_id_t log_id, log_priority prio, int len)
+{
+	struct log_shed_t *shed = log_shed_of[log_id];
+	time_t now;
+	int bytes, level;
+
+	if (!shed || shed->ring_size <= 0)
+		return 0;
+
+	now = time(NULL);
+	if (now - shed->window >= SHED_WINDOW_SEC) {
+		bytes = __sync_lock_test_and_set(&shed->window_bytes, 0);
+		if (now - shed->window > SHED_WINDOW_SEC)
+			bytes = 0;	/* idle for a whole window */
+		shed->window = now;
+		shed_set_level(log_id, shed, shed_level(shed, bytes));
+	}
+
+	bytes = __sync_add_and_fetch(&shed->window_bytes, len);
+	level = shed_level(shed, bytes);
+	if (level > shed->shed_pri)
+		shed_set_level(log_id, shed, level);
+
+	/* only VERBOSE and DEBUG, then INFO, are ever shed */
+	if (!shed->shed_pri || (int)prio < DLOG_VERBOSE || (int)prio > shed->shed_pri)
+		return 0;
+
+	__sync_fetch_and_add(&shed->shed_count, 1);
+	return 1;
+}
+
 static int __write_to_log_kernel(log_id_t log_id, log_priority prio, const char *tag, const char *msg)
 {
 	ssize_t ret;
 	int log_fd;
-	struct iovec vec[3];
+	struct iovec vec[4];
+	struct logger_entry_seq trailer;
 
 	if(log_id >= LOG_ID_APPS && prio<g_debug_level)
 	{
@@ -75,11 +176,42 @@ static int __write_to_log_kernel(log_id_t log_id, log_priority prio, const char
 	vec[2].iov_base	= (void *) msg;
 	vec[2].iov_len	= strlen(msg) + 1;
 
-	ret = writev(log_fd, vec, 3);
+	if (__dlog_should_shed(log_id, prio, sizeof(struct logger_entry) + 1 + vec[1].iov_len + vec[2].iov_len))
+		return 0;
+
+	trailer.seq = ++log_seq[log_id];
+	trailer.log_id = log_id;
+	trailer.magic = LOGGER_SEQ_MAGIC;
+	vec[3].iov_base	= (void *) &trailer;
+	vec[3].iov_len	= sizeof(trailer);
+
+	ret = writev(log_fd, vec, 4);
 
 	return ret;
 }
 
+static void init_shed(void)
+{
+	int i, j;
+
+	for (i = 0; i < LOG_ID_MAX; i++) {
+		log_shed_of[i] = NULL;
+		if (log_fds[i] < 0)
+			continue;
+		/* system and apps may share the main ring */
+		for (j = 0; j < i; j++) {
+			if (log_fds[j] == log_fds[i]) {
+				log_shed_of[i] = log_shed_of[j];
+				break;
+			}
+		}
+		if (!log_shed_of[i]) {
+			log_sheds[i].ring_size = ioctl(log_fds[i], LOGGER_GET_LOG_BUF_SIZE);
+			log_shed_of[i] = &log_sheds[i];
+		}
+	}
+}
+
 void init_debug_level(void)
 {
 	char *debuglevel=getenv("TIZEN_DEBUG_LEVEL");
@@ -128,6 +260,8 @@ static int __dlog_init(log_id_t log_id, log_priority prio, const char *tag, cons
 		{
 			log_fds[LOG_ID_APPS] = log_fds[LOG_ID_MAIN];
 		}
+
+		init_shed();
 	}
 #ifdef HAVE_PTHREADS
     pthread_mutex_unlock(&log_init_lock);
@@ -156,3 +290,52 @@ int __dlog_print(log_id_t log_id, int prio, const char *tag, const char *fmt, ..
     return write_to_log(log_id, prio, tag, buf);
 }
 
+static unsigned int __dlog_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int __dlog_callsite_check(struct dlog_callsite *site, unsigned int every_n, unsigned int every_ms)
+{
+	unsigned int count, now, last;
+
+	if (every_ms) {
+		now = __dlog_now_ms() | 1;	/* 0 means "never logged" */
+		last = site->last_ms;
+		if ((last == 0 || now - last >= every_ms)
+				&& __sync_bool_compare_and_swap(&site->last_ms, last, now))
+			return __sync_lock_test_and_set(&site->suppressed, 0);
+	} else {
+		count = __sync_fetch_and_add(&site->count, 1);
+		if (count == 0 || (every_n && count % every_n == 0))
+			return __sync_lock_test_and_set(&site->suppressed, 0);
+	}
+
+	__sync_fetch_and_add(&site->suppressed, 1);
+	return -1;
+}
+
+int __dlog_print_suppressed(log_id_t log_id, int prio, const char *tag, int suppressed, const char *fmt, ...)
+{
+	va_list ap;
+	char buf[LOG_BUF_SIZE];
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, LOG_BUF_SIZE, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return -1;
+
+	if (suppressed > 0) {
+		if (len >= LOG_BUF_SIZE)
+			len = LOG_BUF_SIZE - 1;
+		snprintf(buf + len, LOG_BUF_SIZE - len, " (suppressed %d)", suppressed);
+	}
+
+	return write_to_log(log_id, prio, tag, buf);
+}
+
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <logbinary.h>
+
+size_t log_binary_put_varint(char* buf, uint64_t value)
+{
+	size_t n = 0;
+
+	while (value >= 0x80) {
+		buf[n++] = (char)(value | 0x80);
+		value >>= 7;
+	}
+	buf[n++] = (char)value;
+
+	return n;
+}
+
+size_t log_binary_get_varint(const unsigned char* p, const unsigned char* end, uint64_t* value)
+{
+	const unsigned char* start = p;
+	uint64_t v = 0;
+	int shift = 0;
+
+	while (p < end && shift < 64) {
+		v |= (uint64_t)(*p & 0x7f) << shift;
+		if (!(*p++ & 0x80)) {
+			*value = v;
+			return p - start;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+uint64_t log_binary_zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+int64_t log_binary_unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+int log_binary_header(char* buf, size_t size, char* const* names, int count)
+{
+	size_t len, name_len;
+	int i;
+
+	if (size < sizeof(LOG_BINARY_MAGIC) + 5) {
+		return -1;
+	}
+	memcpy(buf, LOG_BINARY_MAGIC, sizeof(LOG_BINARY_MAGIC) - 1);
+	len = sizeof(LOG_BINARY_MAGIC) - 1;
+	buf[len++] = LOG_BINARY_VERSION;
+	len += log_binary_put_varint(buf + len, count);
+
+	for (i = 0; i < count; i++) {
+		name_len = strlen(names[i]);
+		if (len + 5 + name_len > size) {
+			return -1;
+		}
+		len += log_binary_put_varint(buf + len, name_len);
+		memcpy(buf + len, names[i], name_len);
+		len += name_len;
+	}
+
+	return len;
+}
+
+size_t log_binary_encode(struct log_binary_writer_t* writer, char* buf,
+		int buffer, const struct logger_entry* entry)
+{
+	int64_t nsec = (int64_t)entry->sec * 1000000000 + entry->nsec;
+	size_t len = 0;
+
+	len += log_binary_put_varint(buf + len, buffer);
+	len += log_binary_put_varint(buf + len, log_binary_zigzag(nsec - writer->last_nsec));
+	len += log_binary_put_varint(buf + len, (uint32_t)entry->pid);
+	len += log_binary_put_varint(buf + len, (uint32_t)entry->tid);
+	len += log_binary_put_varint(buf + len, entry->len);
+	memcpy(buf + len, entry->msg, entry->len);
+	writer->last_nsec = nsec;
+
+	return len + entry->len;
+}
+
+size_t log_binary_decode(const unsigned char* p, const unsigned char* end,
+		int64_t* last_nsec, int* buffer, struct logger_entry* entry)
+{
+	const unsigned char* start = p;
+	uint64_t v[5];
+	size_t n;
+	int64_t nsec;
+	int i;
+
+	// buffer, timestamp delta, pid, tid, length
+	for (i = 0; i < 5; i++) {
+		if (!(n = log_binary_get_varint(p, end, &v[i]))) {
+			return 0;
+		}
+		p += n;
+	}
+	if (v[0] > INT_MAX || v[4] > LOGGER_ENTRY_MAX_PAYLOAD
+			|| v[4] > (uint64_t)(end - p)) {
+		return 0;
+	}
+
+	nsec = *last_nsec + log_binary_unzigzag(v[1]);
+	*last_nsec = nsec;
+	*buffer = (int)v[0];
+	entry->len = (uint16_t)v[4];
+	entry->__pad = 0;
+	entry->pid = (int32_t)v[2];
+	entry->tid = (int32_t)v[3];
+	entry->sec = (int32_t)(nsec / 1000000000);
+	entry->nsec = (int32_t)(nsec % 1000000000);
+	memcpy(entry->msg, p, entry->len);
+
+	return p + entry->len - start;
+}
+
+/* makes up to want bytes available, returns how many are or -1 */
+static ssize_t fill(struct log_binary_reader_t* reader, size_t want)
+{
+	ssize_t n;
+
+	if (reader->map || reader->len - reader->pos >= want) {
+		return reader->len - reader->pos;
+	}
+	memmove(reader->buf, reader->buf + reader->pos, reader->len - reader->pos);
+	reader->buf_offset += reader->pos;
+	reader->len -= reader->pos;
+	reader->pos = 0;
+
+	while (reader->len < want) {
+		n = read(reader->fd, reader->buf + reader->len, sizeof(reader->buf) - reader->len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (n == 0) {
+			break;
+		}
+		reader->len += n;
+	}
+
+	return reader->len;
+}
+
+int log_binary_open(struct log_binary_reader_t* reader, int fd)
+{
+	const unsigned char* p;
+	const unsigned char* end;
+	uint64_t count, name_len;
+	size_t n;
+	ssize_t avail;
+
+	reader->fd = fd;
+	reader->map = NULL;
+	reader->pos = 0;
+	reader->len = 0;
+	reader->buf_offset = 0;
+	reader->end = -1;
+	reader->last_nsec = 0;
+	reader->buffer_count = 0;
+
+	avail = fill(reader, sizeof(reader->buf));
+	if (avail < (ssize_t)sizeof(LOG_BINARY_MAGIC)
+			|| memcmp(reader->buf, LOG_BINARY_MAGIC, sizeof(LOG_BINARY_MAGIC) - 1)
+			|| reader->buf[sizeof(LOG_BINARY_MAGIC) - 1] != LOG_BINARY_VERSION) {
+		errno = EINVAL;
+		return -1;
+	}
+	p = reader->buf + sizeof(LOG_BINARY_MAGIC);
+	end = reader->buf + avail;
+
+	if (!(n = log_binary_get_varint(p, end, &count)) || count > LOG_BINARY_MAX_BUFFERS) {
+		goto bad;
+	}
+	p += n;
+	while (reader->buffer_count < (int)count) {
+		if (!(n = log_binary_get_varint(p, end, &name_len)) || name_len > (uint64_t)(end - p - n)) {
+			goto bad;
+		}
+		p += n;
+		reader->buffers[reader->buffer_count] = strndup((const char *)p, name_len);
+		if (reader->buffers[reader->buffer_count] == NULL) {
+			log_binary_close(reader);
+			return -1;
+		}
+		reader->buffer_count++;
+		p += name_len;
+	}
+	reader->pos = p - reader->buf;
+
+	return 0;
+
+bad:
+	log_binary_close(reader);
+	errno = EINVAL;
+	return -1;
+}
+
+int log_binary_map(struct log_binary_reader_t* reader)
+{
+	struct stat st;
+	void* map;
+
+	if (fstat(reader->fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0
+			|| (uintmax_t)st.st_size > SIZE_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, reader->fd, 0);
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+	// only a hint: readahead more, and drop pages once read past
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	reader->pos = log_binary_tell(reader);
+	reader->buf_offset = 0;
+	reader->len = st.st_size;
+	reader->map = map;
+
+	return 0;
+}
+
+int log_binary_read(struct log_binary_reader_t* reader, int* buffer,
+		struct logger_entry* entry)
+{
+	const unsigned char* base = reader->map ? reader->map : reader->buf;
+	const unsigned char* p;
+	ssize_t avail;
+	size_t n;
+
+	avail = fill(reader, LOG_BINARY_RECORD_MAX);
+	if (avail > 0 && reader->end >= 0) {
+		if (log_binary_tell(reader) >= reader->end) {
+			return 0;
+		}
+		if (avail > reader->end - log_binary_tell(reader)) {
+			avail = reader->end - log_binary_tell(reader);
+		}
+	}
+	if (avail <= 0) {
+		return avail;
+	}
+	p = base + reader->pos;
+
+	n = log_binary_decode(p, p + avail, &reader->last_nsec, buffer, entry);
+	if (n == 0 || *buffer >= reader->buffer_count) {
+		errno = EINVAL;
+		return -1;
+	}
+	reader->pos += n;
+
+	return 1;
+}
+
+int log_binary_seek(struct log_binary_reader_t* reader, off_t offset, int64_t base_nsec)
+{
+	reader->last_nsec = base_nsec;
+	if (reader->map) {
+		if ((size_t)offset > reader->len) {
+			errno = EINVAL;
+			return -1;
+		}
+		reader->pos = offset;
+		return 0;
+	}
+	if (lseek(reader->fd, offset, SEEK_SET) < 0) {
+		return -1;
+	}
+	reader->buf_offset = offset;
+	reader->pos = 0;
+	reader->len = 0;
+
+	return 0;
+}
+
+off_t log_binary_tell(const struct log_binary_reader_t* reader)
+{
+	return reader->buf_offset + reader->pos;
+}
+
+void log_binary_close(struct log_binary_reader_t* reader)
+{
+	int i;
+
+	for (i = 0; i < reader->buffer_count; i++) {
+		free(reader->buffers[i]);
+	}
+	reader->buffer_count = 0;
+	if (reader->map) {
+		munmap((void *)reader->map, reader->len);
+		reader->map = NULL;
+	}
+}
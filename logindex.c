@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <logindex.h>
+#include <logbinary.h>
+
+#define SET_MIN_SIZE	64
+
+static uint32_t hash_tag(const char* tag, size_t len)
+{
+	uint32_t h = 2166136261u;
+
+	while (len--) {
+		h = (h ^ (unsigned char)*tag++) * 16777619u;
+	}
+
+	return h;
+}
+
+static uint32_t hash_pid(uint32_t key)
+{
+	return key * 2654435761u;
+}
+
+static int grow_tags(struct log_index_t* idx)
+{
+	char** old = idx->tags;
+	size_t old_size = idx->tag_size;
+	size_t i;
+
+	idx->tag_size = old_size ? old_size * 2 : SET_MIN_SIZE;
+	idx->tags = (char **)calloc(idx->tag_size, sizeof(char *));
+	if (idx->tags == NULL) {
+		idx->tags = old;
+		idx->tag_size = old_size;
+		return -1;
+	}
+	idx->tag_count = 0;
+	for (i = 0; i < old_size; i++) {
+		if (old[i]) {
+			size_t mask = idx->tag_size - 1;
+			size_t j = hash_tag(old[i], strlen(old[i])) & mask;
+
+			while (idx->tags[j]) {
+				j = (j + 1) & mask;
+			}
+			idx->tags[j] = old[i];
+			idx->tag_count++;
+		}
+	}
+	free(old);
+
+	return 0;
+}
+
+static int add_tag(struct log_index_t* idx, const char* tag, size_t len)
+{
+	size_t mask, i;
+
+	if ((idx->tag_count + 1) * 4 > idx->tag_size * 3 && grow_tags(idx) < 0) {
+		return -1;
+	}
+	mask = idx->tag_size - 1;
+	for (i = hash_tag(tag, len) & mask; idx->tags[i]; i = (i + 1) & mask) {
+		if (!strncmp(idx->tags[i], tag, len) && idx->tags[i][len] == '\0') {
+			return 0;
+		}
+	}
+	idx->tags[i] = strndup(tag, len);
+	if (idx->tags[i] == NULL) {
+		return -1;
+	}
+	idx->tag_count++;
+
+	return 0;
+}
+
+static int grow_pids(struct log_index_t* idx)
+{
+	uint32_t* old = idx->pids;
+	size_t old_size = idx->pid_size;
+	size_t i;
+
+	idx->pid_size = old_size ? old_size * 2 : SET_MIN_SIZE;
+	idx->pids = (uint32_t *)calloc(idx->pid_size, sizeof(uint32_t));
+	if (idx->pids == NULL) {
+		idx->pids = old;
+		idx->pid_size = old_size;
+		return -1;
+	}
+	for (i = 0; i < old_size; i++) {
+		if (old[i]) {
+			size_t mask = idx->pid_size - 1;
+			size_t j = hash_pid(old[i]) & mask;
+
+			while (idx->pids[j]) {
+				j = (j + 1) & mask;
+			}
+			idx->pids[j] = old[i];
+		}
+	}
+	free(old);
+
+	return 0;
+}
+
+static int add_pid(struct log_index_t* idx, int32_t pid)
+{
+	uint32_t key = (uint32_t)pid + 1;
+	size_t mask, i;
+
+	if ((idx->pid_count + 1) * 4 > idx->pid_size * 3 && grow_pids(idx) < 0) {
+		return -1;
+	}
+	mask = idx->pid_size - 1;
+	for (i = hash_pid(key) & mask; idx->pids[i]; i = (i + 1) & mask) {
+		if (idx->pids[i] == key) {
+			return 0;
+		}
+	}
+	idx->pids[i] = key;
+	idx->pid_count++;
+
+	return 0;
+}
+
+bool log_index_has_tag(const struct log_index_t* idx, const char* tag)
+{
+	size_t len = strlen(tag);
+	size_t mask, i;
+
+	if (idx->tag_size == 0) {
+		return false;
+	}
+	mask = idx->tag_size - 1;
+	for (i = hash_tag(tag, len) & mask; idx->tags[i]; i = (i + 1) & mask) {
+		if (!strcmp(idx->tags[i], tag)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool log_index_has_pid(const struct log_index_t* idx, int32_t pid)
+{
+	uint32_t key = (uint32_t)pid + 1;
+	size_t mask, i;
+
+	if (idx->pid_size == 0) {
+		return false;
+	}
+	mask = idx->pid_size - 1;
+	for (i = hash_pid(key) & mask; idx->pids[i]; i = (i + 1) & mask) {
+		if (idx->pids[i] == key) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void log_index_init(struct log_index_t* idx)
+{
+	memset(idx, 0, sizeof(struct log_index_t));
+}
+
+void log_index_reset(struct log_index_t* idx)
+{
+	size_t i;
+
+	for (i = 0; i < idx->tag_size; i++) {
+		free(idx->tags[i]);
+	}
+	if (idx->tags) {
+		memset(idx->tags, 0, idx->tag_size * sizeof(char *));
+	}
+	if (idx->pids) {
+		memset(idx->pids, 0, idx->pid_size * sizeof(uint32_t));
+	}
+	idx->tag_count = 0;
+	idx->pid_count = 0;
+	idx->block_count = 0;
+	idx->min_nsec = 0;
+	idx->max_nsec = 0;
+}
+
+void log_index_free(struct log_index_t* idx)
+{
+	log_index_reset(idx);
+	free(idx->tags);
+	free(idx->pids);
+	free(idx->blocks);
+	log_index_init(idx);
+}
+
+static struct log_index_block_t* new_block(struct log_index_t* idx)
+{
+	struct log_index_block_t* blocks;
+
+	if (idx->block_count == idx->block_alloc) {
+		size_t alloc = idx->block_alloc ? idx->block_alloc * 2 : SET_MIN_SIZE;
+
+		blocks = (struct log_index_block_t *)realloc(idx->blocks, alloc * sizeof(*blocks));
+		if (blocks == NULL) {
+			return NULL;
+		}
+		idx->blocks = blocks;
+		idx->block_alloc = alloc;
+	}
+
+	return &idx->blocks[idx->block_count++];
+}
+
+int log_index_add(struct log_index_t* idx, off_t offset, int64_t base_nsec,
+		const struct logger_entry* entry)
+{
+	int64_t nsec = (int64_t)entry->sec * 1000000000 + entry->nsec;
+	struct log_index_block_t* block;
+
+	block = idx->block_count ? &idx->blocks[idx->block_count - 1] : NULL;
+	if (block == NULL || offset - block->offset >= LOG_INDEX_BLOCK_SIZE) {
+		block = new_block(idx);
+		if (block == NULL) {
+			return -1;
+		}
+		block->offset = offset;
+		block->base_nsec = base_nsec;
+		block->min_nsec = nsec;
+		block->max_nsec = nsec;
+		if (idx->block_count == 1) {
+			idx->min_nsec = nsec;
+			idx->max_nsec = nsec;
+		}
+	}
+	if (nsec < block->min_nsec) {
+		block->min_nsec = nsec;
+	}
+	if (nsec > block->max_nsec) {
+		block->max_nsec = nsec;
+	}
+	if (nsec < idx->min_nsec) {
+		idx->min_nsec = nsec;
+	}
+	if (nsec > idx->max_nsec) {
+		idx->max_nsec = nsec;
+	}
+
+	if (entry->len > 1 && add_tag(idx, entry->msg + 1, strnlen(entry->msg + 1, entry->len - 1)) < 0) {
+		return -1;
+	}
+
+	return add_pid(idx, entry->pid);
+}
+
+int log_index_encode(const struct log_index_t* idx, off_t index_offset, char** buf)
+{
+	const struct log_index_block_t* block;
+	off_t prev_offset = 0;
+	int64_t prev_base = 0;
+	size_t size, len, i, tag_len;
+	uint64_t off;
+	char* p;
+
+	size = 3 * 10 + LOG_INDEX_TRAILER_SIZE + idx->pid_count * 10 + idx->block_count * 40;
+	for (i = 0; i < idx->tag_size; i++) {
+		if (idx->tags[i]) {
+			size += 10 + strlen(idx->tags[i]);
+		}
+	}
+	p = (char *)malloc(size);
+	if (p == NULL) {
+		return -1;
+	}
+
+	len = 0;
+	len += log_binary_put_varint(p + len, log_binary_zigzag(idx->min_nsec));
+	len += log_binary_put_varint(p + len, idx->max_nsec - idx->min_nsec);
+
+	len += log_binary_put_varint(p + len, idx->tag_count);
+	for (i = 0; i < idx->tag_size; i++) {
+		if (idx->tags[i]) {
+			tag_len = strlen(idx->tags[i]);
+			len += log_binary_put_varint(p + len, tag_len);
+			memcpy(p + len, idx->tags[i], tag_len);
+			len += tag_len;
+		}
+	}
+
+	len += log_binary_put_varint(p + len, idx->pid_count);
+	for (i = 0; i < idx->pid_size; i++) {
+		if (idx->pids[i]) {
+			len += log_binary_put_varint(p + len, idx->pids[i] - 1);
+		}
+	}
+
+	len += log_binary_put_varint(p + len, idx->block_count);
+	for (i = 0; i < idx->block_count; i++) {
+		block = &idx->blocks[i];
+		len += log_binary_put_varint(p + len, block->offset - prev_offset);
+		len += log_binary_put_varint(p + len, log_binary_zigzag(block->base_nsec - prev_base));
+		len += log_binary_put_varint(p + len, log_binary_zigzag(block->min_nsec - block->base_nsec));
+		len += log_binary_put_varint(p + len, block->max_nsec - block->min_nsec);
+		prev_offset = block->offset;
+		prev_base = block->base_nsec;
+	}
+
+	off = index_offset;
+	for (i = 0; i < 8; i++) {
+		p[len++] = (char)(off >> (8 * i));
+	}
+	memcpy(p + len, LOG_INDEX_MAGIC, sizeof(LOG_INDEX_MAGIC) - 1);
+	len += sizeof(LOG_INDEX_MAGIC) - 1;
+	p[len++] = LOG_INDEX_VERSION;
+
+	*buf = p;
+
+	return len;
+}
+
+/* reads count varints from *p into values, returns -1 past end */
+static int get_varints(const unsigned char** p, const unsigned char* end, uint64_t* values, int count)
+{
+	size_t n;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		n = log_binary_get_varint(*p, end, &values[i]);
+		if (n == 0) {
+			return -1;
+		}
+		*p += n;
+	}
+
+	return 0;
+}
+
+int log_index_load(struct log_index_t* idx, int fd, off_t* index_offset)
+{
+	unsigned char trailer[LOG_INDEX_TRAILER_SIZE];
+	const unsigned char* p;
+	const unsigned char* end;
+	unsigned char* buf = NULL;
+	struct log_index_block_t* block;
+	struct stat statbuf;
+	off_t offset = 0;
+	uint64_t v[4];
+	uint64_t count, i;
+	size_t len;
+	int64_t base = 0;
+	int j;
+
+	log_index_init(idx);
+	if (fstat(fd, &statbuf) < 0 || statbuf.st_size < LOG_INDEX_TRAILER_SIZE) {
+		return -1;
+	}
+	if (pread(fd, trailer, sizeof(trailer), statbuf.st_size - sizeof(trailer)) != sizeof(trailer)
+			|| memcmp(trailer + 8, LOG_INDEX_MAGIC, sizeof(LOG_INDEX_MAGIC) - 1)
+			|| trailer[15] != LOG_INDEX_VERSION) {
+		return -1;
+	}
+	*index_offset = 0;
+	for (j = 7; j >= 0; j--) {
+		*index_offset = (*index_offset << 8) | trailer[j];
+	}
+	if (*index_offset < 0 || *index_offset > statbuf.st_size - LOG_INDEX_TRAILER_SIZE) {
+		return -1;
+	}
+
+	len = statbuf.st_size - LOG_INDEX_TRAILER_SIZE - *index_offset;
+	buf = (unsigned char *)malloc(len ? len : 1);
+	if (buf == NULL || pread(fd, buf, len, *index_offset) != (ssize_t)len) {
+		goto bad;
+	}
+	p = buf;
+	end = buf + len;
+
+	if (get_varints(&p, end, v, 2) < 0) {
+		goto bad;
+	}
+	idx->min_nsec = log_binary_unzigzag(v[0]);
+	idx->max_nsec = idx->min_nsec + v[1];
+
+	if (get_varints(&p, end, &count, 1) < 0) {
+		goto bad;
+	}
+	for (i = 0; i < count; i++) {
+		if (get_varints(&p, end, v, 1) < 0 || v[0] > (uint64_t)(end - p)
+				|| add_tag(idx, (const char *)p, v[0]) < 0) {
+			goto bad;
+		}
+		p += v[0];
+	}
+
+	if (get_varints(&p, end, &count, 1) < 0) {
+		goto bad;
+	}
+	for (i = 0; i < count; i++) {
+		if (get_varints(&p, end, v, 1) < 0 || add_pid(idx, (int32_t)v[0]) < 0) {
+			goto bad;
+		}
+	}
+
+	if (get_varints(&p, end, &count, 1) < 0) {
+		goto bad;
+	}
+	for (i = 0; i < count; i++) {
+		if (get_varints(&p, end, v, 4) < 0 || (block = new_block(idx)) == NULL) {
+			goto bad;
+		}
+		offset += v[0];
+		base += log_binary_unzigzag(v[1]);
+		block->offset = offset;
+		block->base_nsec = base;
+		block->min_nsec = base + log_binary_unzigzag(v[2]);
+		block->max_nsec = block->min_nsec + v[3];
+	}
+	free(buf);
+
+	return 0;
+
+bad:
+	free(buf);
+	log_index_free(idx);
+	return -1;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <loginput.h>
+#include <logindex.h>
+
+#define LOG_FILE_DIR		"/dev/log_"
+#define STREAM_PREFIX		"stream:"
+#define UNIX_PREFIX		"unix:"
+#define CAPTURE_PREFIX		"capture:"
+
+static bool has_prefix(const char* s, const char* prefix)
+{
+	return !strncmp(s, prefix, strlen(prefix));
+}
+
+char* log_input_name(const char* spec)
+{
+	char* name;
+
+	if (!strcmp(spec, "-") || has_prefix(spec, STREAM_PREFIX)
+			|| has_prefix(spec, UNIX_PREFIX) || has_prefix(spec, CAPTURE_PREFIX)) {
+		return strdup(spec);
+	}
+	name = (char *)malloc(strlen(LOG_FILE_DIR) + strlen(spec) + 1);
+	if (name) {
+		strcpy(name, LOG_FILE_DIR);
+		strcat(name, spec);
+	}
+
+	return name;
+}
+
+static int open_unix(const char* path)
+{
+	static const int types[] = { SOCK_STREAM, SOCK_SEQPACKET };
+	struct sockaddr_un addr;
+	size_t i;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	// framing is the same either way, so take whichever the server is
+	for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		fd = socket(AF_UNIX, types[i], 0);
+		if (fd < 0) {
+			return -1;
+		}
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+			return fd;
+		}
+		close(fd);
+		if (errno != EPROTOTYPE) {
+			break;
+		}
+	}
+
+	return -1;
+}
+
+int log_input_open(struct log_input_t* in, const char* name, int flags)
+{
+	struct log_index_t idx;
+	off_t index_offset;
+	struct stat st;
+	int fl;
+
+	memset(in, 0, sizeof(*in));
+	in->fd = -1;
+
+	if (has_prefix(name, CAPTURE_PREFIX)) {
+		in->kind = LOG_INPUT_CAPTURE;
+		in->capture = (struct log_binary_reader_t *)calloc(1, sizeof(struct log_binary_reader_t));
+		if (in->capture == NULL) {
+			return -1;
+		}
+		in->fd = open(name + strlen(CAPTURE_PREFIX), O_RDONLY);
+		if (in->fd < 0 || log_binary_open(in->capture, in->fd) < 0) {
+			log_input_close(in);
+			return -1;
+		}
+		// records stop where the index of a -S capture starts
+		if (log_index_load(&idx, in->fd, &index_offset) == 0) {
+			in->capture->end = index_offset;
+			log_index_free(&idx);
+		}
+		log_binary_map(in->capture);
+		return 0;
+	}
+
+	if (!strcmp(name, "-")) {
+		in->kind = LOG_INPUT_STREAM;
+		in->fd = dup(STDIN_FILENO);
+	} else if (has_prefix(name, STREAM_PREFIX)) {
+		in->kind = LOG_INPUT_STREAM;
+		in->fd = open(name + strlen(STREAM_PREFIX), O_RDONLY);
+	} else if (has_prefix(name, UNIX_PREFIX)) {
+		in->kind = LOG_INPUT_STREAM;
+		in->fd = open_unix(name + strlen(UNIX_PREFIX));
+	} else {
+		in->kind = LOG_INPUT_DEVICE;
+		in->fd = open(name, flags);
+		in->pollable = true;
+		return in->fd < 0 ? -1 : 0;
+	}
+	if (in->fd < 0) {
+		return -1;
+	}
+
+	in->buf = (unsigned char *)malloc(LOG_INPUT_BUF_SIZE);
+	if (in->buf == NULL || fstat(in->fd, &st) < 0) {
+		log_input_close(in);
+		return -1;
+	}
+	// epoll refuses regular files, which are always readable anyway
+	in->pollable = !S_ISREG(st.st_mode);
+	if ((flags & O_NONBLOCK) && in->pollable) {
+		fl = fcntl(in->fd, F_GETFL);
+		if (fl < 0 || fcntl(in->fd, F_SETFL, fl | O_NONBLOCK) < 0) {
+			log_input_close(in);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* returns the next whole entry of a stream, reading more as needed */
+static int read_stream(struct log_input_t* in, struct logger_entry* entry)
+{
+	const struct logger_entry* head;
+	size_t size;
+	ssize_t n;
+
+	while (1) {
+		if (in->len - in->pos >= sizeof(struct logger_entry)) {
+			head = (const struct logger_entry *)(in->buf + in->pos);
+			if (head->len > LOGGER_ENTRY_MAX_PAYLOAD) {
+				// not framed entries, or out of step
+				errno = EINVAL;
+				return -1;
+			}
+			size = sizeof(struct logger_entry) + head->len;
+			if (in->len - in->pos >= size) {
+				memcpy(entry, head, size);
+				in->pos += size;
+				return size;
+			}
+		}
+
+		// keep the partial entry, and read in behind it
+		memmove(in->buf, in->buf + in->pos, in->len - in->pos);
+		in->len -= in->pos;
+		in->pos = 0;
+		n = read(in->fd, in->buf + in->len, LOG_INPUT_BUF_SIZE - in->len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (n == 0) {
+			if (in->len > 0) {
+				// the writer went away in the middle of an entry
+				errno = EINVAL;
+				return -1;
+			}
+			return 0;
+		}
+		in->len += n;
+	}
+}
+
+int log_input_read(struct log_input_t* in, struct logger_entry* entry)
+{
+	int buffer, ret;
+
+	switch (in->kind) {
+		case LOG_INPUT_STREAM:
+			return read_stream(in, entry);
+
+		case LOG_INPUT_CAPTURE:
+			ret = log_binary_read(in->capture, &buffer, entry);
+			return ret > 0 ? (int)(sizeof(struct logger_entry) + entry->len) : ret;
+
+		default:
+			/* NOTE: driver guarantees we read exactly one full entry */
+			do {
+				ret = read(in->fd, entry, LOGGER_ENTRY_MAX_LEN);
+			} while (ret < 0 && errno == EINTR);
+			return ret;
+	}
+}
+
+void log_input_close(struct log_input_t* in)
+{
+	if (in->capture) {
+		log_binary_close(in->capture);
+		free(in->capture);
+		in->capture = NULL;
+	}
+	free(in->buf);
+	in->buf = NULL;
+	if (in->fd >= 0) {
+		close(in->fd);
+		in->fd = -1;
+	}
+}
@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <logoutput.h>
+#include <loguring.h>
+
+/* user_data of the requests other than writes, which are by buffer */
+#define URING_CLOSE		LOG_OUTPUT_URING_DEPTH
+#define URING_RENAME		(LOG_OUTPUT_URING_DEPTH + 1)
+#define URING_OPEN		(LOG_OUTPUT_URING_DEPTH + 2)
+
+/* how often a rotation in flight is looked after while nothing is written */
+#define URING_POLL_MSEC		10
+
+struct uring_buf_t {
+	char* data;
+	size_t len;		/* bytes to write */
+	size_t done;		/* of them written */
+	off_t offset;
+	unsigned int file;	/* which file it goes to */
+	bool busy;
+};
+
+struct log_output_uring_t {
+	struct log_uring_t ring;
+	struct uring_buf_t bufs[LOG_OUTPUT_URING_DEPTH];
+	bool fixed;		/* buffers are registered */
+	int current;		/* the one out->buf is */
+	off_t offset;		/* where the next write goes */
+	int error;		/* errno of a failed request, reported by the next call */
+	unsigned int file;	/* incremented on rotation */
+	int fds[2];		/* the file and, while rotating, the one before */
+
+	/* rotation in flight */
+	struct log_rotate_t* rot;
+	struct log_segment_t* seg;	/* archive of the old file, NULL once queued */
+	off_t old_offset;
+	int steps;		/* rename, open and close not done yet */
+	bool renamed;
+};
+
+static long long elapsed_msec(const struct timespec* from, const struct timespec* to)
+{
+	return ((long long)to->tv_sec - from->tv_sec) * 1000
+		+ (to->tv_nsec - from->tv_nsec) / 1000000;
+}
+
+/* writes all of iov, returns -1 on error */
+static int write_all(int fd, struct iovec* iov, int iovcnt)
+{
+	ssize_t ret;
+
+	while (iovcnt > 0) {
+		ret = writev(fd, iov, iovcnt);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		while (iovcnt > 0 && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+int log_output_init(struct log_output_t* out, int fd, size_t size, int flush_msec)
+{
+	out->fd = fd;
+	out->size = size;
+	out->len = 0;
+	out->flush_msec = flush_msec;
+	out->interactive = isatty(fd);
+	out->ring = NULL;
+	out->uring = NULL;
+	out->buf = (char *)malloc(size);
+
+	return out->buf ? 0 : -1;
+}
+
+static void mark_first(struct log_output_t* out)
+{
+	if (out->len == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &out->first);
+	}
+}
+
+static bool rotating(const struct log_output_uring_t* u)
+{
+	return u->seg != NULL || u->steps > 0 || u->fds[1] >= 0;
+}
+
+static int submit_write(struct log_output_t* out, int i)
+{
+	struct log_output_uring_t* u = out->uring;
+	struct uring_buf_t* b = &u->bufs[i];
+
+	if (log_uring_write(&u->ring, u->fds[b->file != u->file], b->data + b->done, b->len - b->done,
+				b->offset + b->done, u->fixed ? i : -1, i) < 0) {
+		return -1;
+	}
+	return log_uring_submit(&u->ring);
+}
+
+static void write_done(struct log_output_t* out, int i, int res)
+{
+	struct log_output_uring_t* u = out->uring;
+	struct uring_buf_t* b = &u->bufs[i];
+
+	if (res == -EINTR || res == -EAGAIN) {
+		res = 0;
+	} else if (res <= 0) {
+		u->error = res < 0 ? -res : EIO;
+		b->busy = false;
+		return;
+	}
+	b->done += res;
+	if (b->done < b->len) {
+		// short write: the rest goes after it
+		if (submit_write(out, i) < 0) {
+			u->error = errno;
+			b->busy = false;
+		}
+		return;
+	}
+	b->busy = false;
+}
+
+static void request_done(struct log_output_t* out, uint64_t user_data, int res)
+{
+	struct log_output_uring_t* u = out->uring;
+
+	switch (user_data) {
+		case URING_RENAME:
+			u->steps--;
+			u->renamed = res >= 0;
+			if (res < 0) {
+				// the same file is opened again, and appended to
+				errno = -res;
+				perror("while rotating log files");
+				log_rotate_free_list(u->seg);
+				u->seg = NULL;
+			}
+		break;
+
+		case URING_OPEN:
+			u->steps--;
+			if (res < 0) {
+				u->error = -res;
+				break;
+			}
+			out->fd = u->fds[0] = res;
+			u->offset = u->renamed ? 0 : u->old_offset;
+		break;
+
+		case URING_CLOSE:
+			u->steps--;
+		break;
+
+		default:
+			write_done(out, (int)user_data, res);
+		break;
+	}
+}
+
+/* closes the old file once written, then hands it to the rotation thread */
+static int finish_rotation(struct log_output_t* out)
+{
+	struct log_output_uring_t* u = out->uring;
+	int i;
+
+	if (u->fds[1] >= 0) {
+		for (i = 0; i < LOG_OUTPUT_URING_DEPTH; i++) {
+			if (u->bufs[i].busy && u->bufs[i].file != u->file) {
+				return 0;
+			}
+		}
+		if (log_uring_close(&u->ring, u->fds[1], URING_CLOSE) < 0
+				|| log_uring_submit(&u->ring) < 0) {
+			return -1;
+		}
+		u->fds[1] = -1;
+		u->steps++;
+	}
+	if (u->seg && u->steps == 0) {
+		log_rotate_queue(u->rot, u->seg);
+		u->seg = NULL;
+	}
+
+	return 0;
+}
+
+/* handles the finished requests; with wait, waits for one first */
+static int reap(struct log_output_t* out, bool wait)
+{
+	uint64_t user_data;
+	int res, ret;
+
+	while ((ret = log_uring_reap(&out->uring->ring, &user_data, &res, wait)) > 0) {
+		request_done(out, user_data, res);
+		wait = false;
+	}
+	if (ret < 0) {
+		return -1;
+	}
+
+	return finish_rotation(out);
+}
+
+static int uring_error(struct log_output_uring_t* u)
+{
+	if (u->error) {
+		errno = u->error;
+		return -1;
+	}
+	return 0;
+}
+
+/* submits the buffer, and goes on in a free one */
+static int uring_flush(struct log_output_t* out)
+{
+	struct log_output_uring_t* u = out->uring;
+	struct uring_buf_t* b = &u->bufs[u->current];
+	int i;
+
+	if (reap(out, false) < 0) {
+		return -1;
+	}
+	// the file of a rotation is still being opened
+	while (out->fd < 0 && !u->error) {
+		if (reap(out, true) < 0) {
+			return -1;
+		}
+	}
+	if (uring_error(u) < 0) {
+		return -1;
+	}
+
+	b->len = out->len;
+	b->done = 0;
+	b->offset = u->offset;
+	b->file = u->file;
+	b->busy = true;
+	u->offset += out->len;
+	out->len = 0;
+	if (submit_write(out, u->current) < 0) {
+		return -1;
+	}
+
+	// storage is behind when all buffers are in flight
+	for (;;) {
+		for (i = 1; i <= LOG_OUTPUT_URING_DEPTH; i++) {
+			b = &u->bufs[(u->current + i) % LOG_OUTPUT_URING_DEPTH];
+			if (!b->busy) {
+				u->current = b - u->bufs;
+				out->buf = b->data;
+				return uring_error(u);
+			}
+		}
+		if (reap(out, true) < 0) {
+			return -1;
+		}
+	}
+}
+
+int log_output_use_uring(struct log_output_t* out)
+{
+	struct log_output_uring_t* u;
+	struct iovec iov[LOG_OUTPUT_URING_DEPTH];
+	struct stat statbuf;
+	int flags, i;
+
+	if (out->ring || fstat(out->fd, &statbuf) < 0 || !S_ISREG(statbuf.st_mode)) {
+		errno = EINVAL;
+		return -1;
+	}
+	u = (struct log_output_uring_t *)calloc(1, sizeof(*u));
+	if (u == NULL) {
+		return -1;
+	}
+	// a request per buffer, and the rotation
+	if (log_uring_init(&u->ring, 2 * LOG_OUTPUT_URING_DEPTH) < 0) {
+		free(u);
+		return -1;
+	}
+	u->bufs[0].data = out->buf;
+	for (i = 1; i < LOG_OUTPUT_URING_DEPTH; i++) {
+		u->bufs[i].data = (char *)malloc(out->size);
+		if (u->bufs[i].data == NULL) {
+			goto error;
+		}
+	}
+	// fixed buffers save mapping them on every write, when memlock allows
+	for (i = 0; i < LOG_OUTPUT_URING_DEPTH; i++) {
+		iov[i].iov_base = u->bufs[i].data;
+		iov[i].iov_len = out->size;
+	}
+	u->fixed = log_uring_register_buffers(&u->ring, iov, LOG_OUTPUT_URING_DEPTH) == 0;
+
+	// writes go to their own offsets, so that several can be in flight
+	flags = fcntl(out->fd, F_GETFL);
+	if (flags < 0 || fcntl(out->fd, F_SETFL, flags & ~O_APPEND) < 0
+			|| (u->offset = lseek(out->fd, 0, SEEK_END)) < 0) {
+		goto error;
+	}
+	u->fds[0] = out->fd;
+	u->fds[1] = -1;
+	out->uring = u;
+
+	return 0;
+
+error:
+	for (i = 1; i < LOG_OUTPUT_URING_DEPTH; i++) {
+		free(u->bufs[i].data);
+	}
+	log_uring_free(&u->ring);
+	free(u);
+	return -1;
+}
+
+int log_output_rotate(struct log_output_t* out, const char* path, struct log_rotate_t* rot)
+{
+	struct log_output_uring_t* u = out->uring;
+
+	if (log_output_flush(out) < 0) {
+		return -1;
+	}
+	// one at a time: a file is only queued once written
+	while (rotating(u)) {
+		if (reap(out, true) < 0) {
+			return -1;
+		}
+	}
+	if (uring_error(u) < 0) {
+		return -1;
+	}
+
+	if (!u->ring.file_ops) {
+		// before Linux 5.11: as without io_uring, once the writes are done
+		if (log_output_sync(out) < 0) {
+			return -1;
+		}
+		close(out->fd);
+		if (log_rotate_segment(rot) < 0) {
+			perror("while rotating log files");
+		}
+		out->fd = u->fds[0] = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+		if (out->fd < 0 || (u->offset = lseek(out->fd, 0, SEEK_END)) < 0) {
+			return -1;
+		}
+		return 0;
+	}
+
+	u->seg = log_rotate_next(rot);
+	if (u->seg == NULL) {
+		return -1;
+	}
+	u->rot = rot;
+	u->old_offset = u->offset;
+	u->fds[1] = u->fds[0];
+	u->fds[0] = out->fd = -1;
+	u->file++;
+	// the old file stays open for the writes in flight
+	if (log_uring_rename(&u->ring, path, u->seg->name, LOG_URING_LINK, URING_RENAME) < 0
+			|| log_uring_open(&u->ring, path, O_WRONLY | O_CREAT | O_CLOEXEC,
+				S_IRUSR | S_IWUSR, URING_OPEN) < 0
+			|| log_uring_submit(&u->ring) < 0) {
+		return -1;
+	}
+	u->steps = 2;
+
+	return finish_rotation(out);
+}
+
+int log_output_sync(struct log_output_t* out)
+{
+	struct log_output_uring_t* u = out->uring;
+	int i;
+
+	if (log_output_flush(out) < 0) {
+		return -1;
+	}
+	if (u == NULL) {
+		return 0;
+	}
+	for (i = 0; i < LOG_OUTPUT_URING_DEPTH; i++) {
+		while (u->bufs[i].busy || (i == 0 && rotating(u))) {
+			if (reap(out, true) < 0) {
+				return -1;
+			}
+		}
+	}
+
+	return uring_error(u);
+}
+
+int log_output_close(struct log_output_t* out)
+{
+	struct log_output_uring_t* u = out->uring;
+	int ret, i;
+
+	ret = log_output_sync(out);
+	if (u) {
+		// a failed write may leave a buffer behind
+		for (i = 0; i < LOG_OUTPUT_URING_DEPTH; i++) {
+			if (u->bufs[i].busy) {
+				return ret;
+			}
+		}
+		for (i = 0; i < LOG_OUTPUT_URING_DEPTH; i++) {
+			free(u->bufs[i].data);
+		}
+		log_uring_free(&u->ring);
+		free(u);
+		out->uring = NULL;
+	} else {
+		free(out->buf);
+	}
+	out->buf = NULL;
+
+	return ret;
+}
+
+int log_output_flush(struct log_output_t* out)
+{
+	struct iovec iov;
+
+	if (out->len == 0) {
+		return out->uring ? uring_error(out->uring) : 0;
+	}
+	if (out->ring) {
+		log_ring_append(out->ring, out->buf, out->len);
+		out->len = 0;
+		return 0;
+	}
+	if (out->uring) {
+		return uring_flush(out);
+	}
+	iov.iov_base = out->buf;
+	iov.iov_len = out->len;
+	out->len = 0;
+
+	return write_all(out->fd, &iov, 1);
+}
+
+int log_output_write(struct log_output_t* out, const char* data, size_t len)
+{
+	struct iovec iov[2];
+	size_t n, done;
+
+	if (out->len + len <= out->size) {
+		mark_first(out);
+		memcpy(out->buf + out->len, data, len);
+		out->len += len;
+		return len;
+	}
+
+	if (out->ring) {
+		log_output_flush(out);
+		log_ring_append(out->ring, data, len);
+		return len;
+	}
+
+	if (out->uring) {
+		// the buffers are what is registered, so it is copied in
+		for (done = 0; done < len; done += n) {
+			if (out->len == out->size && log_output_flush(out) < 0) {
+				return -1;
+			}
+			mark_first(out);
+			n = len - done < out->size - out->len ? len - done : out->size - out->len;
+			memcpy(out->buf + out->len, data + done, n);
+			out->len += n;
+		}
+		return len;
+	}
+
+	// too big to buffer: one writev for what we have and the new data
+	iov[0].iov_base = out->buf;
+	iov[0].iov_len = out->len;
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = len;
+	out->len = 0;
+
+	return write_all(out->fd, iov, 2) < 0 ? -1 : (int)len;
+}
+
+int log_output_print_line(struct log_output_t* out, log_format* p_format, const log_entry* entry)
+{
+	char* tail = out->buf + out->len;
+	char* line;
+	size_t len;
+	int ret;
+
+	mark_first(out);
+	line = log_format_log_line(p_format, tail, out->size - out->len, entry, &len);
+	if (line == NULL) {
+		return -1;
+	}
+	if (line == tail) {
+		out->len += len;
+		return len;
+	}
+
+	// did not fit in what is left of the buffer
+	ret = log_output_write(out, line, len);
+	free(line);
+
+	return ret;
+}
+
+int log_output_batch_done(struct log_output_t* out)
+{
+	if (out->uring && reap(out, false) < 0) {
+		return -1;
+	}
+	if (out->interactive || log_output_timeout(out) == 0) {
+		return log_output_flush(out);
+	}
+	return 0;
+}
+
+int log_output_timeout(const struct log_output_t* out)
+{
+	long long ms;
+	struct timespec mono;
+
+	if (out->len == 0) {
+		return out->uring && rotating(out->uring) ? URING_POLL_MSEC : -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	ms = out->flush_msec - elapsed_msec(&out->first, &mono);
+
+	return ms < 0 ? 0 : (int)ms;
+}
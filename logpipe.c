@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <logpipe.h>
+
+#define RECORD_ALIGN(n)	(((n) + 3) & ~(size_t)3)
+
+struct log_batch_t* log_batch_new(void)
+{
+	struct log_batch_t* batch;
+	int i;
+
+	batch = (struct log_batch_t *)malloc(sizeof(struct log_batch_t));
+	if (batch == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < LOG_BATCH_MAX_TEXTS; i++) {
+		batch->text[i].buf = NULL;
+		batch->text[i].size = 0;
+	}
+	log_batch_reset(batch);
+
+	return batch;
+}
+
+bool log_batch_add(struct log_batch_t* batch, uint32_t kind, uint32_t texts,
+		const struct logger_entry* entry)
+{
+	size_t size = RECORD_ALIGN(sizeof(struct log_batch_record_t) + entry->len);
+	struct log_batch_record_t* record;
+
+	if (batch->used + size > LOG_BATCH_SIZE) {
+		return false;
+	}
+	record = (struct log_batch_record_t *)(batch->records + batch->used);
+	record->kind = kind;
+	record->texts = texts;
+	memcpy(&record->entry, entry, sizeof(struct logger_entry) + entry->len);
+	batch->used += size;
+	batch->count++;
+
+	return true;
+}
+
+struct log_batch_record_t* log_batch_next(struct log_batch_t* batch, size_t* pos)
+{
+	struct log_batch_record_t* record;
+
+	if (*pos >= batch->used) {
+		return NULL;
+	}
+	record = (struct log_batch_record_t *)(batch->records + *pos);
+	*pos += RECORD_ALIGN(sizeof(struct log_batch_record_t) + record->entry.len);
+
+	return record;
+}
+
+int log_batch_reserve(struct log_batch_text_t* text, size_t len)
+{
+	size_t size = text->size ? text->size : LOG_BATCH_SIZE;
+	char* buf;
+
+	if (text->len + len <= text->size) {
+		return 0;
+	}
+	while (size < text->len + len) {
+		size *= 2;
+	}
+	buf = (char *)realloc(text->buf, size);
+	if (buf == NULL) {
+		return -1;
+	}
+	text->buf = buf;
+	text->size = size;
+
+	return 0;
+}
+
+void log_batch_reset(struct log_batch_t* batch)
+{
+	int i;
+
+	batch->used = 0;
+	batch->count = 0;
+	for (i = 0; i < LOG_BATCH_MAX_TEXTS; i++) {
+		batch->text[i].len = 0;
+	}
+}
+
+int log_pipe_init(struct log_pipe_t* pipe, size_t size, bool wake)
+{
+	pipe->slots = (struct log_batch_t **)calloc(size, sizeof(struct log_batch_t *));
+	if (pipe->slots == NULL) {
+		return -1;
+	}
+	pipe->size = size;
+	pipe->head = 0;
+	pipe->count = 0;
+	pipe->wake_fd = -1;
+	if (wake) {
+		pipe->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (pipe->wake_fd < 0) {
+			free(pipe->slots);
+			return -1;
+		}
+	}
+	pthread_mutex_init(&pipe->lock, NULL);
+	pthread_cond_init(&pipe->cond, NULL);
+
+	return 0;
+}
+
+void log_pipe_push(struct log_pipe_t* pipe, struct log_batch_t* batch)
+{
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&pipe->lock);
+	while (pipe->count == pipe->size) {
+		pthread_cond_wait(&pipe->cond, &pipe->lock);
+	}
+	pipe->slots[(pipe->head + pipe->count) % pipe->size] = batch;
+	pipe->count++;
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->lock);
+
+	if (pipe->wake_fd >= 0 && write(pipe->wake_fd, &one, sizeof(one)) < 0) {
+		// the counter is already nonzero: the reader is awake anyway
+	}
+}
+
+bool log_pipe_pop(struct log_pipe_t* pipe, struct log_batch_t** batch, int timeout)
+{
+	struct timespec deadline;
+
+	if (timeout > 0) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += timeout / 1000;
+		deadline.tv_nsec += (timeout % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&pipe->lock);
+	while (pipe->count == 0) {
+		if (timeout == 0
+				|| (timeout < 0 && pthread_cond_wait(&pipe->cond, &pipe->lock) != 0)
+				|| (timeout > 0 && pthread_cond_timedwait(&pipe->cond, &pipe->lock, &deadline) == ETIMEDOUT)) {
+			pthread_mutex_unlock(&pipe->lock);
+			return false;
+		}
+	}
+	*batch = pipe->slots[pipe->head];
+	pipe->head = (pipe->head + 1) % pipe->size;
+	pipe->count--;
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->lock);
+
+	return true;
+}
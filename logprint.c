@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -343,6 +347,24 @@ int log_process_log_buffer(struct logger_entry *buf,log_entry *entry)
     tag_len = strlen(entry->tag);
     entry->messageLen = buf->len - tag_len - 3;
     entry->message = entry->tag + tag_len + 1;
+    entry->seq_log_id = -1;
+    entry->seq = 0;
+
+    // strip the sequence trailer appended by libdlog, if any
+    if (buf->len > tag_len + 2 + sizeof(struct logger_entry_seq)
+            && (unsigned char)buf->msg[buf->len - 1] == LOGGER_SEQ_MAGIC) {
+        size_t rest = buf->len - tag_len - 2;
+        size_t msg_len = strnlen(entry->message, rest);
+
+        if (msg_len + 1 + sizeof(struct logger_entry_seq) == rest) {
+            struct logger_entry_seq trailer;
+
+            memcpy(&trailer, entry->message + msg_len + 1, sizeof(trailer));
+            entry->messageLen = msg_len;
+            entry->seq_log_id = trailer.log_id;
+            entry->seq = trailer.seq;
+        }
+    }
 
     return 0;
 }
@@ -367,7 +389,8 @@ char *log_format_log_line (
     struct tm tmBuf;
 #endif
     struct tm* ptm;
-    char timeBuf[32];
+    static __thread time_t timeSec = (time_t)-1;
+    static __thread char timeBuf[32];
  //   char headerBuf[128];
     char prefixBuf[128], suffixBuf[128];
     char priChar;
@@ -385,13 +408,17 @@ char *log_format_log_line (
      * in the time stamp.  Don't use forward slashes, parenthesis,
      * brackets, asterisks, or other special chars here.
      */
+    // the date only changes once a second: keep it per thread
+    if (entry->tv_sec != timeSec) {
 #if defined(HAVE_LOCALTIME_R)
-    ptm = localtime_r(&(entry->tv_sec), &tmBuf);
+        ptm = localtime_r(&(entry->tv_sec), &tmBuf);
 #else
-    ptm = localtime(&(entry->tv_sec));
+        ptm = localtime(&(entry->tv_sec));
 #endif
-    //strftime(timeBuf, sizeof(timeBuf), "%Y-%m-%d %H:%M:%S", ptm);
-    strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
+        //strftime(timeBuf, sizeof(timeBuf), "%Y-%m-%d %H:%M:%S", ptm);
+        strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
+        timeSec = entry->tv_sec;
+    }
 
     /*
      * Construct a buffer containing the log header and log message.
@@ -663,6 +690,28 @@ void logprint_run_tests()
     err = log_add_filter_string(p_format, "*:s random:z");
     assert(err < 0);
 
+    // sequence trailer is split off the message
+    {
+        union {
+            unsigned char buf[LOGGER_ENTRY_MAX_LEN] __attribute__((aligned(4)));
+            struct logger_entry entry;
+        } u;
+        struct logger_entry_seq trailer = { 42, LOG_ID_RADIO, LOGGER_SEQ_MAGIC };
+        log_entry entry;
+
+        memset(&u, 0, sizeof(u));
+        memcpy(u.entry.msg, "\x04tag\0hello", 11);
+        u.entry.len = 11;
+        assert(log_process_log_buffer(&u.entry, &entry) == 0);
+        assert(entry.messageLen == 5 && entry.seq_log_id == -1);
+
+        memcpy(u.entry.msg + 11, &trailer, sizeof(trailer));
+        u.entry.len = 11 + sizeof(trailer);
+        assert(log_process_log_buffer(&u.entry, &entry) == 0);
+        assert(entry.messageLen == 5 && 0 == strncmp(entry.message, "hello", 5));
+        assert(entry.seq_log_id == LOG_ID_RADIO && entry.seq == 42);
+    }
+
 
 #if 0
     char *ret;
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <logqueue.h>
+
+struct log_chunk_t {
+	struct log_chunk_t* next;	/* spare list link */
+	size_t used;
+	unsigned int live;		/* entries not freed yet */
+	union {
+		char data[0];
+		struct logger_entry align;
+	};
+};
+
+#define CHUNK_DATA_SIZE		(LOG_ARENA_CHUNK_SIZE - offsetof(struct log_chunk_t, data))
+#define ENTRY_ALIGN		(sizeof(void *))
+
+static size_t entry_size(size_t payload_len)
+{
+	size_t size = offsetof(struct queued_entry_t, entry) + sizeof(struct logger_entry) + payload_len + 1;
+
+	return (size + ENTRY_ALIGN - 1) & ~(ENTRY_ALIGN - 1);
+}
+
+static void chunk_release(struct log_arena_t* arena, struct log_chunk_t* chunk)
+{
+	if (arena->spare_count < LOG_ARENA_MAX_SPARE) {
+		chunk->next = arena->spare;
+		arena->spare = chunk;
+		arena->spare_count++;
+	} else {
+		free(chunk);
+		arena->chunk_count--;
+	}
+}
+
+static struct log_chunk_t* chunk_get(struct log_arena_t* arena)
+{
+	struct log_chunk_t* chunk = arena->spare;
+
+	if (chunk) {
+		arena->spare = chunk->next;
+		arena->spare_count--;
+	} else {
+		chunk = (struct log_chunk_t *)malloc(LOG_ARENA_CHUNK_SIZE);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		arena->chunk_count++;
+	}
+	chunk->next = NULL;
+	chunk->used = 0;
+	chunk->live = 0;
+
+	return chunk;
+}
+
+void log_arena_init(struct log_arena_t* arena)
+{
+	memset(arena, 0, sizeof(*arena));
+}
+
+struct queued_entry_t* log_arena_alloc(struct log_arena_t* arena, size_t payload_len)
+{
+	struct log_chunk_t* chunk = arena->current;
+	struct queued_entry_t* entry;
+	size_t size = entry_size(payload_len);
+
+	if (size > CHUNK_DATA_SIZE) {
+		return NULL;
+	}
+
+	if (chunk == NULL || chunk->used + size > CHUNK_DATA_SIZE) {
+		// retire the current chunk; whoever frees its last entry recycles it
+		if (chunk && chunk->live == 0) {
+			chunk_release(arena, chunk);
+		}
+		chunk = arena->current = chunk_get(arena);
+		if (chunk == NULL) {
+			return NULL;
+		}
+	}
+
+	entry = (struct queued_entry_t *)(chunk->data + chunk->used);
+	chunk->used += size;
+	chunk->live++;
+	arena->live_entries++;
+	arena->live_bytes += size;
+
+	entry->next = NULL;
+	entry->chunk = chunk;
+	entry->lost = 0;
+
+	return entry;
+}
+
+void log_arena_free(struct log_arena_t* arena, struct queued_entry_t* entry)
+{
+	struct log_chunk_t* chunk = entry->chunk;
+
+	arena->live_entries--;
+	arena->live_bytes -= entry_size(entry->entry.len);
+
+	if (--chunk->live == 0) {
+		if (chunk == arena->current) {
+			// nothing left in it, start over instead of moving on
+			chunk->used = 0;
+		} else {
+			chunk_release(arena, chunk);
+		}
+	}
+}
+
+struct queued_entry_t* log_arena_copy(struct log_arena_t* arena, const struct logger_entry* buf)
+{
+	struct queued_entry_t* entry;
+
+	entry = log_arena_alloc(arena, buf->len);
+	if (entry == NULL) {
+		return NULL;
+	}
+	memcpy(&entry->entry, buf, sizeof(struct logger_entry) + buf->len);
+	entry->entry.msg[buf->len] = '\0';
+
+	return entry;
+}
+
+size_t log_arena_footprint(const struct log_arena_t* arena)
+{
+	return arena->chunk_count * LOG_ARENA_CHUNK_SIZE;
+}
+
+int log_entry_cmp(const struct logger_entry* a, const struct logger_entry* b)
+{
+	int n = a->sec - b->sec;
+	if (n != 0)
+	{
+		return n;
+	}
+	return a->nsec - b->nsec;
+}
+
+static int queue_less(const struct log_queue_t* a, const struct log_queue_t* b)
+{
+	return log_entry_cmp(&a->head->entry, &b->head->entry) < 0;
+}
+
+static void heap_set(struct log_merge_t* merge, int i, struct log_queue_t* queue)
+{
+	merge->heap[i] = queue;
+	queue->heap_index = i;
+}
+
+static void heap_up(struct log_merge_t* merge, int i)
+{
+	struct log_queue_t* queue = merge->heap[i];
+
+	while (i > 0 && queue_less(queue, merge->heap[(i - 1) / 2])) {
+		heap_set(merge, i, merge->heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	heap_set(merge, i, queue);
+}
+
+static void heap_down(struct log_merge_t* merge, int i)
+{
+	struct log_queue_t* queue = merge->heap[i];
+	int child;
+
+	while ((child = 2 * i + 1) < merge->size) {
+		if (child + 1 < merge->size && queue_less(merge->heap[child + 1], merge->heap[child])) {
+			child++;
+		}
+		if (!queue_less(merge->heap[child], queue)) {
+			break;
+		}
+		heap_set(merge, i, merge->heap[child]);
+		i = child;
+	}
+	heap_set(merge, i, queue);
+}
+
+int log_merge_add(struct log_merge_t* merge, struct log_queue_t* queue, void* owner)
+{
+	struct log_queue_t** heap;
+
+	heap = (struct log_queue_t **)realloc(merge->heap, (merge->nqueues + 1) * sizeof(*heap));
+	if (heap == NULL) {
+		return -1;
+	}
+	merge->heap = heap;
+	merge->nqueues++;
+	merge->idle++;
+
+	queue->head = queue->tail = NULL;
+	queue->count = 0;
+	queue->heap_index = -1;
+	queue->waited = 1;
+	queue->owner = owner;
+
+	return 0;
+}
+
+void log_merge_wait(struct log_merge_t* merge, struct log_queue_t* queue, int waited)
+{
+	waited = !!waited;
+	if (queue->waited == waited) {
+		return;
+	}
+	queue->waited = waited;
+	if (queue->head == NULL) {
+		merge->idle += waited ? 1 : -1;
+	}
+}
+
+void log_merge_push(struct log_merge_t* merge, struct log_queue_t* queue, struct queued_entry_t* entry)
+{
+	entry->next = NULL;
+	if (queue->tail) {
+		queue->tail->next = entry;
+		queue->tail = entry;
+	} else {
+		queue->head = queue->tail = entry;
+		merge->idle -= queue->waited;
+		heap_set(merge, merge->size++, queue);
+		heap_up(merge, queue->heap_index);
+	}
+	queue->count++;
+}
+
+struct log_queue_t* log_merge_first(const struct log_merge_t* merge)
+{
+	return merge->size ? merge->heap[0] : NULL;
+}
+
+struct queued_entry_t* log_merge_pop(struct log_merge_t* merge, struct log_queue_t* queue)
+{
+	struct queued_entry_t* entry = queue->head;
+	int i = queue->heap_index;
+
+	queue->head = entry->next;
+	queue->count--;
+	if (queue->head) {
+		// normally the new head only sinks, unless the clock went back
+		heap_down(merge, i);
+		heap_up(merge, queue->heap_index);
+	} else {
+		queue->tail = NULL;
+		queue->heap_index = -1;
+		merge->idle += queue->waited;
+		if (i != --merge->size) {
+			struct log_queue_t* moved = merge->heap[merge->size];
+
+			heap_set(merge, i, moved);
+			heap_down(merge, i);
+			heap_up(merge, moved->heap_index);
+		}
+	}
+	entry->next = NULL;
+
+	return entry;
+}
+
+struct queued_entry_t* log_merge_remove(struct log_merge_t* merge, struct log_queue_t* queue,
+		struct queued_entry_t* prev)
+{
+	struct queued_entry_t* entry;
+
+	if (prev == NULL) {
+		return log_merge_pop(merge, queue);
+	}
+	// the head stays, so the heap doesn't change
+	entry = prev->next;
+	prev->next = entry->next;
+	if (queue->tail == entry) {
+		queue->tail = prev;
+	}
+	queue->count--;
+	entry->next = NULL;
+
+	return entry;
+}
+
+struct log_queue_t* log_merge_ready(const struct log_merge_t* merge, int32_t sec, int32_t nsec)
+{
+	struct log_queue_t* first = log_merge_first(merge);
+
+	if (first == NULL) {
+		return NULL;
+	}
+	if (merge->idle == 0) {
+		return first;
+	}
+	if (first->head->entry.sec < sec
+			|| (first->head->entry.sec == sec && first->head->entry.nsec <= nsec)) {
+		return first;
+	}
+	return NULL;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the queued entry arena against one malloc()ed
+ * LOGGER_ENTRY_MAX_LEN buffer per record, the way dlogutil used to queue
+ * entries. Each round queues a backlog of records of realistic sizes and
+ * then drains it in order, as read_log_lines does for a dump.
+ *
+ * It also merges a dump of the same size spread over four devices, with
+ * the sorted per-device lists and linear device scan dlogutil used to
+ * have and with the merge heap.
+ *
+ * usage: logqueue_bench [<records per round> [<rounds>]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <logqueue.h>
+
+/* the old layout: a full-size buffer per record */
+struct malloc_entry_t {
+	union {
+		unsigned char buf[LOGGER_ENTRY_MAX_LEN + 1] __attribute__((aligned(4)));
+		struct logger_entry entry __attribute__((aligned(4)));
+	};
+	unsigned int lost;
+	struct malloc_entry_t* next;
+};
+
+static union {
+	unsigned char buf[LOGGER_ENTRY_MAX_LEN + 1] __attribute__((aligned(4)));
+	struct logger_entry entry __attribute__((aligned(4)));
+} g_record;
+
+/* mostly short messages with the occasional long dump */
+static size_t record_len(unsigned int *seed)
+{
+	unsigned int r = rand_r(seed);
+
+	if (r % 100 == 0) {
+		return 1024 + r % (LOGGER_ENTRY_MAX_PAYLOAD - 1024);
+	}
+	return 40 + r % 200;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t run_malloc(int records, int rounds)
+{
+	struct malloc_entry_t *head, **tail, *e;
+	unsigned int seed = 1;
+	int i, r;
+
+	for (r = 0; r < rounds; r++) {
+		head = NULL;
+		tail = &head;
+		for (i = 0; i < records; i++) {
+			g_record.entry.len = record_len(&seed);
+			e = (struct malloc_entry_t *)malloc(sizeof(*e));
+			if (e == NULL) {
+				exit(1);
+			}
+			memcpy(e->buf, g_record.buf, sizeof(struct logger_entry) + g_record.entry.len);
+			e->next = NULL;
+			*tail = e;
+			tail = &e->next;
+		}
+		while (head) {
+			e = head;
+			head = e->next;
+			free(e);
+		}
+	}
+
+	return (size_t)records * sizeof(struct malloc_entry_t);
+}
+
+static size_t run_arena(int records, int rounds)
+{
+	struct log_arena_t arena;
+	struct queued_entry_t *head, **tail, *e;
+	unsigned int seed = 1;
+	size_t peak = 0;
+	int i, r;
+
+	log_arena_init(&arena);
+	for (r = 0; r < rounds; r++) {
+		head = NULL;
+		tail = &head;
+		for (i = 0; i < records; i++) {
+			g_record.entry.len = record_len(&seed);
+			e = log_arena_copy(&arena, &g_record.entry);
+			if (e == NULL) {
+				exit(1);
+			}
+			*tail = e;
+			tail = &e->next;
+		}
+		if (log_arena_footprint(&arena) > peak) {
+			peak = log_arena_footprint(&arena);
+		}
+		while (head) {
+			e = head;
+			head = e->next;
+			log_arena_free(&arena, e);
+		}
+	}
+
+	return peak;
+}
+
+static void bench(const char *name, size_t (*run)(int, int), int records, int rounds)
+{
+	struct rusage usage;
+	double start, elapsed;
+	size_t queued;
+	pid_t pid;
+	int status;
+
+	/* run in a child so each allocator gets its own peak RSS */
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		start = now_sec();
+		queued = run(records, rounds);
+		elapsed = now_sec() - start;
+		printf("%-8s %8.1f ns/record %10.0f records/s %8zu KB queued",
+				name, elapsed * 1e9 / ((double)records * rounds),
+				(double)records * rounds / elapsed, queued / 1024);
+		fflush(stdout);
+		exit(0);
+	}
+	wait4(pid, &status, 0, &usage);
+	printf(" %8ld KB max RSS\n", usage.ru_maxrss);
+}
+
+#define MERGE_DEVICES 4
+
+struct list_entry_t {
+	struct logger_entry entry;
+	struct list_entry_t* next;
+};
+
+/* interleaved timestamps, each device in order */
+static void stamp(struct logger_entry* entry, int i)
+{
+	entry->sec = i / 1000;
+	entry->nsec = (i % 1000) * 1000000;
+}
+
+static double merge_list(int records)
+{
+	struct list_entry_t* queue[MERGE_DEVICES] = { NULL };
+	struct list_entry_t* entries;
+	struct list_entry_t **e, *entry;
+	double start = now_sec();
+	int i, d, first;
+
+	entries = (struct list_entry_t *)calloc(records, sizeof(*entries));
+	for (i = 0; i < records; i++) {
+		entry = &entries[i];
+		stamp(&entry->entry, i);
+		e = &queue[i % MERGE_DEVICES];
+		while (*e && log_entry_cmp(&entry->entry, &(*e)->entry) >= 0) {
+			e = &(*e)->next;
+		}
+		entry->next = *e;
+		*e = entry;
+	}
+	for (;;) {
+		for (first = -1, d = 0; d < MERGE_DEVICES; d++) {
+			if (queue[d] && (first < 0 || log_entry_cmp(&queue[d]->entry, &queue[first]->entry) < 0)) {
+				first = d;
+			}
+		}
+		if (first < 0) {
+			break;
+		}
+		queue[first] = queue[first]->next;
+	}
+	free(entries);
+
+	return now_sec() - start;
+}
+
+static double merge_heap(int records)
+{
+	struct log_arena_t arena;
+	struct log_merge_t merge;
+	struct log_queue_t queue[MERGE_DEVICES];
+	struct log_queue_t* first;
+	struct queued_entry_t* entry;
+	double start = now_sec();
+	int i, last = -1;
+
+	log_arena_init(&arena);
+	memset(&merge, 0, sizeof(merge));
+	for (i = 0; i < MERGE_DEVICES; i++) {
+		log_merge_add(&merge, &queue[i], NULL);
+	}
+	for (i = 0; i < records; i++) {
+		g_record.entry.len = 60;
+		stamp(&g_record.entry, i);
+		log_merge_push(&merge, &queue[i % MERGE_DEVICES], log_arena_copy(&arena, &g_record.entry));
+	}
+	while ((first = log_merge_first(&merge)) != NULL) {
+		entry = log_merge_pop(&merge, first);
+		i = entry->entry.sec * 1000 + entry->entry.nsec / 1000000;
+		if (i <= last) {
+			fprintf(stderr, "merge out of order\n");
+			exit(1);
+		}
+		last = i;
+		log_arena_free(&arena, entry);
+	}
+	free(merge.heap);
+
+	return now_sec() - start;
+}
+
+int main(int argc, char **argv)
+{
+	int records = argc > 1 ? atoi(argv[1]) : 20000;
+	int rounds = argc > 2 ? atoi(argv[2]) : 50;
+
+	memset(&g_record, 'x', sizeof(g_record));
+	printf("%d records per round, %d rounds\n", records, rounds);
+	bench("malloc", run_malloc, records, rounds);
+	bench("arena", run_arena, records, rounds);
+
+	printf("merging %d records from %d devices\n", records, MERGE_DEVICES);
+	printf("list     %8.1f ms\n", merge_list(records) * 1e3);
+	printf("heap     %8.1f ms\n", merge_heap(records) * 1e3);
+
+	return 0;
+}
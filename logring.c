@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <logring.h>
+
+static int valid_header(const struct log_ring_header_t* header, size_t size)
+{
+	return header->magic == LOG_RING_MAGIC
+		&& header->version == LOG_RING_VERSION
+		&& header->size == size
+		&& header->head < size
+		&& header->tail < size;
+}
+
+static size_t ring_used(const struct log_ring_t* ring)
+{
+	const struct log_ring_header_t* header = ring->header;
+
+	return (header->tail + ring->size - header->head) % ring->size;
+}
+
+int log_ring_open(struct log_ring_t* ring, const char* path, size_t size)
+{
+	struct stat statbuf;
+	off_t total = LOG_RING_HEADER_SIZE + size;
+	void* map;
+
+	ring->fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (ring->fd < 0) {
+		return -1;
+	}
+	if (fstat(ring->fd, &statbuf) < 0) {
+		goto error;
+	}
+	if (statbuf.st_size != total) {
+		// reserve every block now, so a full disk can't fault the mapping later
+		if (ftruncate(ring->fd, 0) < 0) {
+			goto error;
+		}
+		if (posix_fallocate(ring->fd, 0, total) != 0) {
+			goto error;
+		}
+	}
+
+	map = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if (map == MAP_FAILED) {
+		goto error;
+	}
+	ring->header = (struct log_ring_header_t *)map;
+	ring->data = (char *)map + LOG_RING_HEADER_SIZE;
+	ring->size = size;
+
+	if (!valid_header(ring->header, size)) {
+		memset(ring->header, 0, sizeof(struct log_ring_header_t));
+		ring->header->magic = LOG_RING_MAGIC;
+		ring->header->version = LOG_RING_VERSION;
+		ring->header->size = size;
+	}
+
+	return 0;
+
+error:
+	close(ring->fd);
+	return -1;
+}
+
+/* copies len bytes to the ring at offset, wrapping at the end */
+static void ring_copy(struct log_ring_t* ring, size_t offset, const char* data, size_t len)
+{
+	size_t first = ring->size - offset;
+
+	if (len <= first) {
+		memcpy(ring->data + offset, data, len);
+	} else {
+		memcpy(ring->data + offset, data, first);
+		memcpy(ring->data, data + first, len - first);
+	}
+}
+
+/* returns the offset just past the first newline at or after offset */
+static size_t ring_next_line(const struct log_ring_t* ring, size_t offset)
+{
+	const char* nl;
+
+	nl = (const char *)memchr(ring->data + offset, '\n', ring->size - offset);
+	if (nl == NULL) {
+		nl = (const char *)memchr(ring->data, '\n', offset);
+	}
+	if (nl == NULL) {
+		return ring->header->tail;
+	}
+
+	return (nl - ring->data + 1) % ring->size;
+}
+
+void log_ring_append(struct log_ring_t* ring, const char* data, size_t len)
+{
+	struct log_ring_header_t* header = ring->header;
+	size_t room, need;
+	const char* nl;
+	uint64_t tail;
+
+	// one byte stays free, so that head == tail means empty
+	if (len > ring->size - 1) {
+		nl = (const char *)memchr(data + len - (ring->size - 1), '\n', ring->size - 1);
+		if (nl == NULL) {
+			return;
+		}
+		// nl + 1 is where the newest lines that fit begin
+		if (nl + 1 == data + len) {
+			return;
+		}
+		len -= nl + 1 - data;
+		data = nl + 1;
+		header->head = header->tail;
+	}
+
+	room = ring->size - 1 - ring_used(ring);
+	if (room < len) {
+		// drop whole lines from the head, up to the first newline that
+		// leaves enough room
+		need = len - room;
+		header->head = ring_next_line(ring, (header->head + need - 1) % ring->size);
+	}
+
+	ring_copy(ring, header->tail, data, len);
+	tail = header->tail + len;
+	if (tail >= ring->size) {
+		tail -= ring->size;
+		header->generation++;
+	}
+	// the data has to be in place before a reader can see the new tail
+	__sync_synchronize();
+	header->tail = tail;
+}
+
+void log_ring_close(struct log_ring_t* ring)
+{
+	munmap(ring->header, LOG_RING_HEADER_SIZE + ring->size);
+	close(ring->fd);
+}
+
+int log_ring_print(const char* path, int fd)
+{
+	struct log_ring_header_t* header;
+	struct stat statbuf;
+	struct iovec iov[2];
+	char* data;
+	size_t size;
+	void* map;
+	int infd, iovcnt, ret;
+
+	infd = open(path, O_RDONLY);
+	if (infd < 0) {
+		return -1;
+	}
+	if (fstat(infd, &statbuf) < 0 || statbuf.st_size <= LOG_RING_HEADER_SIZE) {
+		close(infd);
+		errno = EINVAL;
+		return -1;
+	}
+	map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, infd, 0);
+	close(infd);
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+	header = (struct log_ring_header_t *)map;
+	data = (char *)map + LOG_RING_HEADER_SIZE;
+	size = statbuf.st_size - LOG_RING_HEADER_SIZE;
+
+	if (!valid_header(header, size)) {
+		munmap(map, statbuf.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	iov[0].iov_base = data + header->head;
+	if (header->tail >= header->head) {
+		iov[0].iov_len = header->tail - header->head;
+		iovcnt = 1;
+	} else {
+		iov[0].iov_len = size - header->head;
+		iov[1].iov_base = data;
+		iov[1].iov_len = header->tail;
+		iovcnt = 2;
+	}
+
+	ret = 0;
+	while (iovcnt > 0) {
+		ssize_t n = writev(fd, iov, iovcnt);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			ret = -1;
+			break;
+		}
+		while (iovcnt > 0 && (size_t)n >= iov[0].iov_len) {
+			n -= iov[0].iov_len;
+			iov[0] = iov[1];
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov[0].iov_base = (char *)iov[0].iov_base + n;
+			iov[0].iov_len -= n;
+		}
+	}
+	munmap(map, statbuf.st_size);
+
+	return ret;
+}
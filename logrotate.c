@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#if defined(DLOG_COMPRESS_GZIP)
+#include <zlib.h>
+#elif defined(DLOG_COMPRESS_ZSTD)
+#include <zstd.h>
+#endif
+
+#include <logrotate.h>
+
+#define COPY_BUF_SIZE	(64 * 1024)
+#define TMP_SUFFIX	".tmp"
+
+static struct log_segment_t* new_segment(const char* name, unsigned int gen)
+{
+	struct log_segment_t* seg;
+
+	seg = (struct log_segment_t *)calloc(1, sizeof(struct log_segment_t));
+	if (seg == NULL) {
+		return NULL;
+	}
+	seg->name = strdup(name);
+	if (seg->name == NULL) {
+		free(seg);
+		return NULL;
+	}
+	seg->gen = gen;
+
+	return seg;
+}
+
+static void free_segment(struct log_segment_t* seg)
+{
+	free(seg->name);
+	free(seg);
+}
+
+/* keeps list sorted by generation */
+static void insert_segment(struct log_segment_t** list, struct log_segment_t* seg)
+{
+	while (*list && (*list)->gen < seg->gen) {
+		list = &(*list)->next;
+	}
+	seg->next = *list;
+	*list = seg;
+}
+
+/* returns name with the codec suffix, or the uncompressed name */
+static void archive_name(const struct log_segment_t* seg, char* buf, size_t size)
+{
+	snprintf(buf, size, "%s%s", seg->name, seg->compressed ? LOG_ROTATE_SUFFIX : "");
+}
+
+#if defined(DLOG_COMPRESS_GZIP)
+
+/* compresses in into out, and closes out */
+static int compress_fd(int in, int out)
+{
+	char buf[COPY_BUF_SIZE];
+	gzFile gz;
+	ssize_t n;
+	int ret = 0;
+
+	gz = gzdopen(out, "wb");
+	if (gz == NULL) {
+		close(out);
+		return -1;
+	}
+	while ((n = read(in, buf, sizeof(buf))) > 0) {
+		if (gzwrite(gz, buf, n) != n) {
+			ret = -1;
+			break;
+		}
+	}
+	if (n < 0) {
+		ret = -1;
+	}
+	if (gzclose(gz) != Z_OK) {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+#elif defined(DLOG_COMPRESS_ZSTD)
+
+static int write_all(int fd, const char* buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* compresses in into out, and closes out */
+static int compress_fd(int in, int out)
+{
+	ZSTD_CCtx* cctx = ZSTD_createCCtx();
+	size_t in_size = ZSTD_CStreamInSize();
+	size_t out_size = ZSTD_CStreamOutSize();
+	char* ibuf = (char *)malloc(in_size);
+	char* obuf = (char *)malloc(out_size);
+	ZSTD_EndDirective mode;
+	ZSTD_inBuffer input;
+	ZSTD_outBuffer output;
+	size_t remaining;
+	ssize_t n;
+	int ret = -1;
+	int finished;
+
+	if (cctx == NULL || ibuf == NULL || obuf == NULL) {
+		goto out;
+	}
+	do {
+		n = read(in, ibuf, in_size);
+		if (n < 0) {
+			goto out;
+		}
+		mode = n == 0 ? ZSTD_e_end : ZSTD_e_continue;
+		input.src = ibuf;
+		input.size = n;
+		input.pos = 0;
+		do {
+			output.dst = obuf;
+			output.size = out_size;
+			output.pos = 0;
+			remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+			if (ZSTD_isError(remaining)) {
+				goto out;
+			}
+			if (write_all(out, obuf, output.pos) < 0) {
+				goto out;
+			}
+			finished = mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size;
+		} while (!finished);
+	} while (n > 0);
+	ret = 0;
+
+out:
+	free(obuf);
+	free(ibuf);
+	ZSTD_freeCCtx(cctx);
+	if (close(out) < 0) {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+#endif
+
+/* compresses seg next to itself and removes the uncompressed file */
+static void compress_segment(struct log_rotate_t* rot, struct log_segment_t* seg)
+{
+	struct stat statbuf;
+	char name[PATH_MAX];
+
+	if (rot->compress) {
+#if defined(DLOG_COMPRESS_GZIP) || defined(DLOG_COMPRESS_ZSTD)
+		char tmp[PATH_MAX];
+		int in, out;
+
+		snprintf(tmp, sizeof(tmp), "%s%s%s", seg->name, LOG_ROTATE_SUFFIX, TMP_SUFFIX);
+		in = open(seg->name, O_RDONLY);
+		if (in < 0) {
+			perror("while compressing rotated log");
+			return;
+		}
+		out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (out < 0 || compress_fd(in, out) < 0) {
+			perror("while compressing rotated log");
+			unlink(tmp);
+		} else {
+			seg->compressed = true;
+			archive_name(seg, name, sizeof(name));
+			if (rename(tmp, name) < 0) {
+				perror("while compressing rotated log");
+				unlink(tmp);
+				seg->compressed = false;
+			} else {
+				unlink(seg->name);
+			}
+		}
+		close(in);
+#endif
+	}
+
+	archive_name(seg, name, sizeof(name));
+	seg->size = stat(name, &statbuf) < 0 ? 0 : statbuf.st_size;
+}
+
+/* adds seg to the archives and deletes the oldest ones over budget */
+static void archive_segment(struct log_rotate_t* rot, struct log_segment_t* seg, off_t budget)
+{
+	struct log_segment_t* old;
+	char name[PATH_MAX];
+
+	insert_segment(&rot->archives, seg);
+	rot->archived_bytes += seg->size;
+
+	// the newest archive is kept even if it is over the budget by itself
+	while (budget > 0 && rot->archived_bytes > budget && rot->archives->next) {
+		old = rot->archives;
+		rot->archives = old->next;
+		rot->archived_bytes -= old->size;
+		archive_name(old, name, sizeof(name));
+		if (unlink(name) < 0 && errno != ENOENT) {
+			perror("while removing rotated log");
+		}
+		free_segment(old);
+	}
+}
+
+static void* rotate_worker(void* arg)
+{
+	struct log_rotate_t* rot = (struct log_rotate_t *)arg;
+	struct log_segment_t* seg;
+	off_t budget;
+
+	pthread_mutex_lock(&rot->lock);
+	while (1) {
+		while (rot->pending == NULL && !rot->stop) {
+			pthread_cond_wait(&rot->cond, &rot->lock);
+		}
+		seg = rot->pending;
+		if (seg == NULL) {
+			break;
+		}
+		rot->pending = seg->next;
+		budget = rot->budget;
+		pthread_mutex_unlock(&rot->lock);
+
+		compress_segment(rot, seg);
+		archive_segment(rot, seg, budget);
+
+		pthread_mutex_lock(&rot->lock);
+	}
+	pthread_mutex_unlock(&rot->lock);
+
+	return NULL;
+}
+
+/*
+ * Lists the archives next to path, "<base>.<gen>.<date>-<time>" followed
+ * by the codec suffix, or by nothing if not compressed, oldest first.
+ * With clean, the leftovers of interrupted compressions are removed.
+ */
+static int list_archives(const char* path, struct log_segment_t** list, bool clean)
+{
+	char dir[PATH_MAX];
+	char name[PATH_MAX + NAME_MAX + 2];
+	char date[9], clock[7];
+	const char* base;
+	const char* rest;
+	struct log_segment_t* seg;
+	struct stat statbuf;
+	struct dirent* de;
+	size_t base_len;
+	unsigned int gen;
+	int n;
+	DIR* dp;
+
+	base = strrchr(path, '/');
+	if (base) {
+		snprintf(dir, sizeof(dir), "%.*s", (int)(base - path), path);
+		if (dir[0] == '\0') {
+			strcpy(dir, "/");
+		}
+		base++;
+	} else {
+		strcpy(dir, ".");
+		base = path;
+	}
+	base_len = strlen(base);
+
+	dp = opendir(dir);
+	if (dp == NULL) {
+		return -1;
+	}
+	while ((de = readdir(dp)) != NULL) {
+		if (strncmp(de->d_name, base, base_len) || de->d_name[base_len] != '.') {
+			continue;
+		}
+		n = 0;
+		if (sscanf(de->d_name + base_len + 1, "%u.%8[0-9]-%6[0-9]%n", &gen, date, clock, &n) != 3 || n == 0) {
+			continue;
+		}
+		rest = de->d_name + base_len + 1 + n;
+
+		if (strlen(rest) >= strlen(TMP_SUFFIX)
+				&& !strcmp(rest + strlen(rest) - strlen(TMP_SUFFIX), TMP_SUFFIX)) {
+			// an interrupted compression
+			if (clean) {
+				snprintf(name, sizeof(name), "%s/%s", dir, de->d_name);
+				unlink(name);
+			}
+			continue;
+		}
+		if (strcmp(rest, LOG_ROTATE_SUFFIX) && rest[0] != '\0') {
+			continue;
+		}
+
+		snprintf(name, sizeof(name), "%s/%.*s", dir, (int)(rest - de->d_name), de->d_name);
+		seg = new_segment(name, gen);
+		if (seg == NULL) {
+			closedir(dp);
+			log_rotate_free_list(*list);
+			*list = NULL;
+			return -1;
+		}
+		seg->compressed = rest[0] != '\0';
+		snprintf(name, sizeof(name), "%s/%s", dir, de->d_name);
+		seg->size = stat(name, &statbuf) < 0 ? 0 : statbuf.st_size;
+		insert_segment(list, seg);
+	}
+	closedir(dp);
+
+	return 0;
+}
+
+/* picks up the archives of an earlier run, and queues the uncompressed ones */
+static int scan_archives(struct log_rotate_t* rot)
+{
+	struct log_segment_t* list = NULL;
+	struct log_segment_t* seg;
+
+	if (list_archives(rot->path, &list, true) < 0) {
+		return -1;
+	}
+	while ((seg = list) != NULL) {
+		list = seg->next;
+		if (seg->gen >= rot->gen) {
+			rot->gen = seg->gen + 1;
+		}
+		if (!seg->compressed && rot->compress) {
+			insert_segment(&rot->pending, seg);
+		} else {
+			insert_segment(&rot->archives, seg);
+			rot->archived_bytes += seg->size;
+		}
+	}
+
+	return 0;
+}
+
+int log_rotate_list(const char* path, struct log_segment_t** list)
+{
+	*list = NULL;
+
+	return list_archives(path, list, false);
+}
+
+void log_rotate_free_list(struct log_segment_t* list)
+{
+	struct log_segment_t* seg;
+
+	while ((seg = list) != NULL) {
+		list = seg->next;
+		free_segment(seg);
+	}
+}
+
+int log_rotate_start(struct log_rotate_t* rot, const char* path, off_t budget, bool compress)
+{
+	memset(rot, 0, sizeof(struct log_rotate_t));
+	rot->path = strdup(path);
+	if (rot->path == NULL) {
+		return -1;
+	}
+	rot->budget = budget;
+	rot->compress = compress && LOG_ROTATE_SUFFIX[0] != '\0';
+	rot->gen = 1;
+	pthread_mutex_init(&rot->lock, NULL);
+	pthread_cond_init(&rot->cond, NULL);
+
+	if (scan_archives(rot) < 0) {
+		return -1;
+	}
+	if (pthread_create(&rot->thread, NULL, rotate_worker, rot) != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+struct log_segment_t* log_rotate_next(struct log_rotate_t* rot)
+{
+	char name[PATH_MAX];
+	char stamp[32];
+	time_t now;
+	struct tm tm;
+
+	now = time(NULL);
+	localtime_r(&now, &tm);
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+	snprintf(name, sizeof(name), "%s.%u.%s", rot->path, rot->gen, stamp);
+
+	return new_segment(name, rot->gen);
+}
+
+void log_rotate_queue(struct log_rotate_t* rot, struct log_segment_t* seg)
+{
+	struct log_segment_t** tail;
+
+	rot->gen = seg->gen + 1;
+
+	pthread_mutex_lock(&rot->lock);
+	for (tail = &rot->pending; *tail; tail = &(*tail)->next)
+		;
+	*tail = seg;
+	pthread_cond_signal(&rot->cond);
+	pthread_mutex_unlock(&rot->lock);
+}
+
+int log_rotate_segment(struct log_rotate_t* rot)
+{
+	struct log_segment_t* seg;
+
+	seg = log_rotate_next(rot);
+	if (seg == NULL) {
+		return -1;
+	}
+	if (rename(rot->path, seg->name) < 0) {
+		free_segment(seg);
+		return -1;
+	}
+	log_rotate_queue(rot, seg);
+
+	return 0;
+}
+
+void log_rotate_set_budget(struct log_rotate_t* rot, off_t budget)
+{
+	pthread_mutex_lock(&rot->lock);
+	rot->budget = budget;
+	pthread_mutex_unlock(&rot->lock);
+}
+
+void log_rotate_stop(struct log_rotate_t* rot)
+{
+	pthread_mutex_lock(&rot->lock);
+	rot->stop = true;
+	pthread_cond_signal(&rot->cond);
+	pthread_mutex_unlock(&rot->lock);
+	pthread_join(rot->thread, NULL);
+
+	log_rotate_free_list(rot->archives);
+	rot->archives = NULL;
+	free(rot->path);
+	rot->path = NULL;
+}
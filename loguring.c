@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <loguring.h>
+
+#ifdef DLOG_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+static int has_op(const struct io_uring_probe* probe, int op)
+{
+	return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+}
+
+/* leaves file_ops set if close, rename and open are supported */
+static int probe_ops(struct log_uring_t* ring)
+{
+	struct io_uring_probe* probe;
+	int ret = -1;
+
+	probe = (struct io_uring_probe *)calloc(1, sizeof(*probe) + 256 * sizeof(probe->ops[0]));
+	if (probe == NULL) {
+		return -1;
+	}
+	// probing itself came with 5.6, as did plain writes
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) < 0
+			|| !has_op(probe, IORING_OP_WRITE)) {
+		errno = ENOSYS;
+		goto out;
+	}
+	ring->file_ops = has_op(probe, IORING_OP_CLOSE) && has_op(probe, IORING_OP_OPENAT)
+		&& has_op(probe, IORING_OP_RENAMEAT);
+	ret = 0;
+out:
+	free(probe);
+	return ret;
+}
+
+int log_uring_init(struct log_uring_t* ring, unsigned int entries)
+{
+	struct io_uring_params params;
+	char* sq;
+	char* cq;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&params, 0, sizeof(params));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0) {
+		return -1;
+	}
+	ring->entries = params.sq_entries;
+
+	ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_map_size > ring->sq_map_size) {
+			ring->sq_map_size = ring->cq_map_size;
+		}
+		ring->cq_map_size = 0;
+	}
+	ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_map == MAP_FAILED) {
+		ring->sq_map = NULL;
+		goto error;
+	}
+	if (ring->cq_map_size == 0) {
+		ring->cq_map = ring->sq_map;
+	} else {
+		ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_map == MAP_FAILED) {
+			ring->cq_map = NULL;
+			goto error;
+		}
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto error;
+	}
+
+	sq = (char *)ring->sq_map;
+	ring->sq_head = (unsigned int *)(sq + params.sq_off.head);
+	ring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+	cq = (char *)ring->cq_map;
+	ring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+
+	if (probe_ops(ring) < 0) {
+		goto error;
+	}
+
+	return 0;
+
+error:
+	log_uring_free(ring);
+	return -1;
+}
+
+int log_uring_register_buffers(struct log_uring_t* ring, const struct iovec* iov, int count)
+{
+	return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov, count) < 0 ? -1 : 0;
+}
+
+/* returns a cleared entry at the tail of the submission queue, or NULL */
+static struct io_uring_sqe* queue_sqe(struct log_uring_t* ring, int opcode, int fd, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe;
+	unsigned int tail;
+
+	tail = ring->tail;
+	if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == ring->entries) {
+		errno = EBUSY;
+		return NULL;
+	}
+	sqe = &ring->sqes[tail & *ring->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = user_data;
+	ring->sq_array[tail & *ring->sq_mask] = tail & *ring->sq_mask;
+	ring->tail++;
+
+	return sqe;
+}
+
+int log_uring_write(struct log_uring_t* ring, int fd, const void* buf, size_t len,
+		off_t offset, int buf_index, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = queue_sqe(ring, buf_index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, user_data);
+	if (sqe == NULL) {
+		return -1;
+	}
+	sqe->addr = (uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = offset;
+	if (buf_index >= 0) {
+		sqe->buf_index = buf_index;
+	}
+
+	return 0;
+}
+
+int log_uring_close(struct log_uring_t* ring, int fd, uint64_t user_data)
+{
+	return queue_sqe(ring, IORING_OP_CLOSE, fd, user_data) ? 0 : -1;
+}
+
+int log_uring_rename(struct log_uring_t* ring, const char* from, const char* to,
+		int flags, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = queue_sqe(ring, IORING_OP_RENAMEAT, AT_FDCWD, user_data);
+	if (sqe == NULL) {
+		return -1;
+	}
+	// the kernel copies the paths when the request is submitted
+	sqe->addr = (uintptr_t)from;
+	sqe->len = AT_FDCWD;
+	sqe->addr2 = (uintptr_t)to;
+	if (flags & LOG_URING_LINK) {
+		sqe->flags |= IOSQE_IO_HARDLINK;
+	}
+
+	return 0;
+}
+
+int log_uring_open(struct log_uring_t* ring, const char* path, int flags, mode_t mode,
+		uint64_t user_data)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = queue_sqe(ring, IORING_OP_OPENAT, AT_FDCWD, user_data);
+	if (sqe == NULL) {
+		return -1;
+	}
+	sqe->addr = (uintptr_t)path;
+	sqe->len = mode;
+	sqe->open_flags = flags;
+
+	return 0;
+}
+
+static int enter(struct log_uring_t* ring, unsigned int to_submit, unsigned int min_complete)
+{
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+				min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+int log_uring_submit(struct log_uring_t* ring)
+{
+	unsigned int pending;
+
+	// publish the entries before the tail that hands them over
+	__atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+	pending = ring->tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (pending == 0) {
+		return 0;
+	}
+
+	return enter(ring, pending, 0) < 0 ? -1 : 0;
+}
+
+int log_uring_reap(struct log_uring_t* ring, uint64_t* user_data, int* res, bool wait)
+{
+	struct io_uring_cqe* cqe;
+	unsigned int head;
+
+	head = *ring->cq_head;
+	while (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		if (!wait) {
+			return 0;
+		}
+		if (enter(ring, 0, 1) < 0) {
+			return -1;
+		}
+	}
+	cqe = &ring->cqes[head & *ring->cq_mask];
+	*user_data = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+void log_uring_free(struct log_uring_t* ring)
+{
+	if (ring->sqes) {
+		munmap(ring->sqes, ring->sqes_size);
+	}
+	if (ring->cq_map && ring->cq_map != ring->sq_map) {
+		munmap(ring->cq_map, ring->cq_map_size);
+	}
+	if (ring->sq_map) {
+		munmap(ring->sq_map, ring->sq_map_size);
+	}
+	if (ring->fd >= 0) {
+		close(ring->fd);
+	}
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+#else /* !DLOG_IO_URING */
+
+int log_uring_init(struct log_uring_t* ring, unsigned int entries)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+	errno = ENOSYS;
+	return -1;
+}
+
+int log_uring_register_buffers(struct log_uring_t* ring, const struct iovec* iov, int count)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int log_uring_write(struct log_uring_t* ring, int fd, const void* buf, size_t len,
+		off_t offset, int buf_index, uint64_t user_data)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int log_uring_close(struct log_uring_t* ring, int fd, uint64_t user_data)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int log_uring_rename(struct log_uring_t* ring, const char* from, const char* to,
+		int flags, uint64_t user_data)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int log_uring_open(struct log_uring_t* ring, const char* path, int flags, mode_t mode,
+		uint64_t user_data)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int log_uring_submit(struct log_uring_t* ring)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int log_uring_reap(struct log_uring_t* ring, uint64_t* user_data, int* res, bool wait)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+void log_uring_free(struct log_uring_t* ring)
+{
+}
+
+#endif /* DLOG_IO_URING */
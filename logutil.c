@@ -26,73 +26,304 @@
 #include <sys/time.h>
 #include <ctype.h>
 #include <errno.h>
+#include <getopt.h>
 #include <assert.h>
+#include <limits.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 
 
 #include <logger.h>
 #include <logprint.h>
+#include <logqueue.h>
+#include <logoutput.h>
+#include <logrotate.h>
+#include <logring.h>
+#include <logbinary.h>
+#include <logwindow.h>
+#include <logindex.h>
+#include <logpipe.h>
+#include <loginput.h>
 
 #define DEFAULT_LOG_ROTATE_SIZE_KBYTES 16
 #define DEFAULT_MAX_ROTATED_LOGS 4
+#define DEFAULT_REORDER_MSEC 20
+#define BATCHES_PER_THREAD 4
+#define BATCH_ROOM (2 * LOGGER_ENTRY_MAX_LEN)
+#define LINE_ROOM 1024
 
-#define LOG_FILE_DIR    "/dev/log_"
 
-static log_format* g_logformat;
 static bool g_nonblock = false;
 static int g_tail_lines = 0;
 
-static const char * g_output_filename = NULL;
-static int g_log_rotate_size_kbytes = 0;                   // 0 means "no log rotation"
-static int g_max_rotated_logs = DEFAULT_MAX_ROTATED_LOGS; // 0 means "unbounded"
-static int g_outfd = -1;
-static off_t g_out_byte_count = 0;
+/*
+ * Where formatted lines go. The options given before any --sink describe
+ * the first sink, and each --sink one more, with buffers, filters, format
+ * and file of its own. Every entry is still read and parsed only once.
+ * A binary capture is always written by the first sink. With -C, the
+ * sinks come from a file instead, which is read again on SIGHUP.
+ */
+#define MAX_SINKS LOG_BATCH_MAX_TEXTS
+
+struct log_sink_t {
+	log_format* format;
+	char* filename;			/* NULL for stdout */
+	int rotate_kbytes;		/* 0 means "no log rotation" */
+	int max_rotated;		/* 0 means "unbounded" */
+	int ring_kbytes;		/* 0 means "no ring file" */
+	char** buffers;			/* device names it takes, all if none */
+	int buffer_count;
+	struct log_output_t output;
+	struct log_rotate_t rotate;
+	struct log_ring_t ring;
+	off_t byte_count;
+};
+
+static struct log_sink_t* g_sinks[MAX_SINKS];
+static int g_sink_count = 1;
+static char** g_default_buffers;                          // taken by sinks without -b
+static int g_default_buffer_count = 0;
+static const char* g_config_path = NULL;
+static pthread_mutex_t g_sinks_lock = PTHREAD_MUTEX_INITIALIZER;  // kept by the writer thread
+static bool g_io_uring = false;                           // write files through io_uring
+static bool g_binary = false;
+static struct log_binary_writer_t g_binary_writer;
+static char g_binary_header[1024];
+static int g_binary_header_len = 0;
+static bool g_store = false;
+static struct log_index_t g_index;
+
+/* what -F prints from a capture, for --since, --until, --tag and --pid */
+static int64_t g_since_nsec = INT64_MIN;
+static int64_t g_until_nsec = INT64_MAX;
+static const char* g_query_tag = NULL;
+static int32_t g_query_pid = -1;
 static int g_dev_count = 0;
 
-struct queued_entry_t {
-	union {
-		unsigned char buf[LOGGER_ENTRY_MAX_LEN + 1] __attribute__((aligned(4)));
-		struct logger_entry entry __attribute__((aligned(4)));
-	};
-	struct queued_entry_t* next;
+static struct log_arena_t g_arena;
+static struct log_merge_t g_merge;
+static int g_reorder_msec = DEFAULT_REORDER_MSEC;
+static int g_batch_msec = 0;
+
+/*
+ * With -q, queued entries may hold g_queue_budget bytes, past which the
+ * --drop policy brings them back under a low water mark: dropping the
+ * lowest priority entries first, the oldest first, or reading nothing
+ * more until printing catches up.
+ */
+enum {
+	DROP_PRIORITY,
+	DROP_OLDEST,
+	DROP_PAUSE,
 };
+static size_t g_queue_budget = 0;                          // 0 means "no limit"
+static int g_drop_policy = DROP_PRIORITY;
+static bool g_paused = false;
 
-static int cmp(struct queued_entry_t* a, struct queued_entry_t* b)
-{
-	int n = a->entry.sec - b->entry.sec;
-	if (n != 0)
-	{
-		return n;
-	}
-	return a->entry.nsec - b->entry.nsec;
-}
+/*
+ * With -j, the reader copies entries in print order into batches, which
+ * go round robin to g_format_threads formatters and are written out in
+ * the same order by the writer thread. A batch comes back to
+ * g_free_batches once written, and when none is free the reader leaves
+ * entries queued instead of blocking.
+ */
+static int g_format_threads = -1;                         // 0 means "format on the reader thread"
+static struct log_pipe_t g_free_batches;
+static struct log_pipe_t* g_format_in;
+static struct log_pipe_t* g_format_out;
+static pthread_t* g_formatters;
+static pthread_t g_writer;
+static struct log_batch_t* g_batch = NULL;                // being filled by the reader
+static unsigned int g_dispatch_next = 0;
+
+/*
+ * With -u, a line that repeats the last one printed for its pid, within
+ * g_dedup_msec of that one, is not printed. The repeats are counted, and
+ * reported in a single line once the pid prints something else or the
+ * window is over.
+ */
+#define DEDUP_TABLE_MIN_SIZE 64
+#define DEDUP_TABLE_MAX_SIZE 4096
+
+/* the last line printed for one pid, and how often it came again since */
+struct dedup_state_t {
+	int32_t pid;		/* 0 for a free slot */
+	int priority;
+	uint64_t hash;		/* of the tag and message */
+	int64_t first_nsec;	/* when the printed line was written */
+	int64_t last_nsec;	/* when its last repeat was */
+	unsigned int repeats;
+	uint32_t sinks;		/* that printed it */
+};
+
+struct dedup_table_t {
+	struct dedup_state_t* slots;
+	unsigned int size;	/* power of two */
+	unsigned int used;
+	unsigned int pending;	/* slots with repeats to report */
+	int64_t due_nsec;	/* no pending window ends before it */
+};
+
+static int g_dedup_msec = 0;                              // 0 means "print every repeat"
+static struct dedup_table_t g_dedups;
+
+/*
+ * With --window, entries are kept in memory instead of printed, until one
+ * of them matches a trigger or SIGUSR1 comes. The window is printed then,
+ * and so is everything up to g_post_msec after the trigger.
+ */
+#define DEFAULT_POST_MSEC 5000
+
+static int g_window_kbytes = 0;                           // 0 means "print as read"
+static struct log_window_t g_window;
+static struct log_device_t** g_window_devs;               // by id, of the entries held
+static int g_window_dev_count = 0;
+static log_format* g_triggers;                            // filters entries trigger with
+static const char* g_trigger_match = NULL;                // or text in their message
+static int g_post_msec = DEFAULT_POST_MSEC;
+static int64_t g_post_until_nsec = INT64_MIN;
+static int64_t g_newest_nsec = INT64_MIN;                 // of the entries read, for SIGUSR1
+
+/* every record is read here first, then copied into the arena at its size */
+static union {
+	unsigned char buf[LOGGER_ENTRY_MAX_LEN + 1] __attribute__((aligned(4)));
+	struct logger_entry entry __attribute__((aligned(4)));
+} g_readbuf;
+
+#define SEQ_TABLE_MIN_SIZE 64
+#define SEQ_TABLE_MAX_SIZE 4096
+
+/* last sequence number seen from one writer thread and log id */
+struct seq_state_t {
+	int32_t tid;		/* 0 for a free slot */
+	int32_t pid;
+	int log_id;
+	uint32_t seq;
+};
+
+struct seq_table_t {
+	struct seq_state_t* slots;
+	unsigned int size;	/* power of two */
+	unsigned int used;
+};
 
 
 struct log_device_t {
 	char* device;
-	int fd;
+	int id;			/* buffer number in binary captures */
+	struct log_input_t input;
+	bool ended;		/* a source other than a device ran out */
 	bool printed;
-	struct queued_entry_t* queue;
+	uint32_t sinks;		/* bit n set if g_sinks[n] takes its entries */
+	struct log_queue_t queue;
+	struct seq_table_t seqs;
+	unsigned long lost;
+	unsigned long dropped;		/* over the queue budget */
+	unsigned long dropped_unreported;
+	long dump_left;		/* bytes -d still reads, -1 for all there is */
 	struct log_device_t* next;
 };
 
-static void enqueue(struct log_device_t* device, struct queued_entry_t* entry)
+static struct log_device_t* new_log_device(char* device)
 {
-	if( device->queue == NULL)
-	{
-		device->queue = entry;
+	static int next_id = 0;
+	struct log_device_t* dev;
+
+	dev = (struct log_device_t *)calloc(1, sizeof(struct log_device_t));
+	if (dev == NULL) {
+		fprintf(stderr,"Can't malloc log_device\n");
+		exit(-1);
 	}
-	else
-	{
-		struct queued_entry_t** e = &device->queue;
-		while(*e && cmp(entry, *e) >= 0 )
-		{
-			e = &((*e)->next);
+	dev->device = device;
+	dev->id = next_id++;
+	dev->input.fd = -1;
+	dev->dump_left = -1;
+	dev->printed = false;
+	dev->next = NULL;
+	if (log_merge_add(&g_merge, &dev->queue, dev) < 0) {
+		fprintf(stderr,"Can't malloc log_device\n");
+		exit(-1);
+	}
+
+	return dev;
+}
+
+static struct seq_state_t* seq_lookup(struct seq_table_t* table, int32_t tid, int log_id)
+{
+	unsigned int i, mask;
+	struct seq_state_t* old;
+	unsigned int old_size;
+
+	if (table->used * 4 >= table->size * 3) {
+		old = table->slots;
+		old_size = table->size;
+		if (old_size >= SEQ_TABLE_MAX_SIZE) {
+			// too many writers came and went: forget them all
+			memset(old, 0, old_size * sizeof(*old));
+			table->used = 0;
+		} else {
+			table->size = old_size ? old_size * 2 : SEQ_TABLE_MIN_SIZE;
+			table->slots = (struct seq_state_t *)calloc(table->size, sizeof(*old));
+			if (table->slots == NULL) {
+				fprintf(stderr,"Can't malloc seq table\n");
+				exit(-1);
+			}
+			table->used = 0;
+			for (i = 0; i < old_size; i++) {
+				if (old[i].tid) {
+					*seq_lookup(table, old[i].tid, old[i].log_id) = old[i];
+				}
+			}
+			free(old);
 		}
-		entry->next = *e;
-		*e = entry;
-    }
+	}
+
+	mask = table->size - 1;
+	for (i = ((uint32_t)tid * 2654435761u + log_id) & mask; ; i = (i + 1) & mask) {
+		struct seq_state_t* slot = &table->slots[i];
+		if (slot->tid == 0) {
+			slot->tid = tid;
+			slot->log_id = log_id;
+			slot->pid = 0;
+			slot->seq = 0;
+			table->used++;
+			return slot;
+		}
+		if (slot->tid == tid && slot->log_id == log_id) {
+			return slot;
+		}
+	}
+}
+
+/*
+ * Returns the number of records the writer of entry wrote before it that
+ * never reached us, going by the sequence trailer libdlog appends.
+ */
+static unsigned int seq_check(struct log_device_t* dev, struct logger_entry* buf)
+{
+	log_entry entry;
+	struct seq_state_t* state;
+	unsigned int lost = 0;
+
+	if (log_process_log_buffer(buf, &entry) < 0 || entry.seq_log_id < 0) {
+		return 0;
+	}
+
+	state = seq_lookup(&dev->seqs, buf->tid, entry.seq_log_id);
+	// a new pid or a restarted count is a new writer reusing the tid
+	if (state->pid == buf->pid && entry.seq > state->seq) {
+		lost = entry.seq - state->seq - 1;
+	}
+	state->pid = buf->pid;
+	state->seq = entry.seq;
+	dev->lost += lost;
+
+	return lost;
 }
 
 static int open_logfile (const char *pathname)
@@ -100,46 +331,188 @@ static int open_logfile (const char *pathname)
     return open(pathname, O_WRONLY | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR);
 }
 
-static void rotate_logs()
+/* names the buffers of devices in the header of binary captures */
+static void setBinaryHeader(struct log_device_t* devices)
 {
-    int err;
+	struct log_device_t* dev;
+	char* names[LOG_BINARY_MAX_BUFFERS] = { NULL };
+	int count = 0;
 	int i;
-	char file0[256]={0};
-	char file1[256]={0};
+
+	for (dev = devices; dev; dev = dev->next) {
+		if (dev->id >= LOG_BINARY_MAX_BUFFERS) {
+			fprintf(stderr,"Too many buffers for a binary capture\n");
+			exit(-1);
+		}
+		names[dev->id] = dev->device;
+		if (dev->id >= count) {
+			count = dev->id + 1;
+		}
+	}
+	for (i = 0; i < count; i++) {
+		if (names[i] == NULL) {
+			names[i] = (char *)"";
+		}
+	}
+
+	g_binary_header_len = log_binary_header(g_binary_header, sizeof(g_binary_header), names, count);
+	if (g_binary_header_len < 0) {
+		fprintf(stderr,"Buffer names too long for a binary capture\n");
+		exit(-1);
+	}
+}
+
+/* every binary capture file starts with a header and absolute timestamps */
+static void startBinaryFile(void)
+{
+	if (log_output_write(&g_sinks[0]->output, g_binary_header, g_binary_header_len) < 0) {
+		perror("output error");
+		exit(-1);
+	}
+	g_sinks[0]->byte_count += g_binary_header_len;
+	g_binary_writer.last_nsec = 0;
+	log_index_reset(&g_index);
+}
+
+/* appends the index of the records written since startBinaryFile() */
+static void finishBinaryFile(void)
+{
+	char* footer;
+	int len;
+
+	if (!g_store) {
+		return;
+	}
+	len = log_index_encode(&g_index, g_sinks[0]->byte_count, &footer);
+	if (len < 0) {
+		fprintf(stderr,"Can't malloc segment index\n");
+		exit(-1);
+	}
+	if (log_output_write(&g_sinks[0]->output, footer, len) < 0) {
+		perror("output error");
+		exit(-1);
+	}
+	g_sinks[0]->byte_count += len;
+	free(footer);
+}
+
+static void rotate_logs(struct log_sink_t* sink)
+{
+    bool binary = g_binary && sink == g_sinks[0];
 
     // Can't rotate logs if we're not outputting to a file
-    if (g_output_filename == NULL) {
+    if (sink->filename == NULL) {
         return;
     }
 
-    close(g_outfd);
+    if (binary) {
+        finishBinaryFile();
+    }
+    if (log_output_flush(&sink->output) < 0) {
+        perror("output error");
+        exit(-1);
+    }
 
-    for (i = g_max_rotated_logs ; i > 0 ; i--)
-	{
-		snprintf(file1, 255, "%s.%d", g_output_filename, i);
+    if (sink->output.uring) {
+        // the file is swapped behind the writes still in flight
+        if (log_output_rotate(&sink->output, sink->filename, &sink->rotate) < 0) {
+            perror("while rotating log files");
+            exit(-1);
+        }
+    } else {
+        close(sink->output.fd);
 
-		if (i - 1 == 0) {
-			snprintf(file0, 255, "%s", g_output_filename);
-		} else {
-			snprintf(file0, 255, "%s.%d", g_output_filename, i - 1);
-		}
+        // compression and retention happen on the rotation thread
+        if (log_rotate_segment(&sink->rotate) < 0) {
+            perror("while rotating log files");
+        }
 
-		err = rename (file0, file1);
+        sink->output.fd = open_logfile (sink->filename);
 
-		if (err < 0 && errno != ENOENT) {
-			perror("while rotating log files");
-		}
+        if (sink->output.fd < 0) {
+            perror ("couldn't open output file");
+            exit(-1);
+        }
     }
 
-    g_outfd = open_logfile (g_output_filename);
+    sink->byte_count = 0;
 
-    if (g_outfd < 0) {
-        perror ("couldn't open output file");
-        exit(-1);
+    if (binary) {
+        startBinaryFile();
     }
+}
+
+/* counts len bytes written to sink, and rotates its file when full */
+static void sinkWritten(struct log_sink_t* sink, size_t len)
+{
+	sink->byte_count += len;
+	if (sink->rotate_kbytes > 0 && (sink->byte_count / 1024) >= sink->rotate_kbytes) {
+		rotate_logs(sink);
+	}
+}
+
+static void writeSink(struct log_sink_t* sink, const char* buf, size_t len)
+{
+	if (log_output_write(&sink->output, buf, len) < 0) {
+		perror("output error");
+		exit(-1);
+	}
+	sinkWritten(sink, len);
+}
+
+/* writes out what the sinks buffer, and waits until it is written */
+static void flushSinks(void)
+{
+	int i;
+
+	for (i = 0; i < g_sink_count; i++) {
+		if (log_output_sync(&g_sinks[i]->output) < 0) {
+			perror("output error");
+			exit(-1);
+		}
+	}
+}
+
+/*
+ * Returns msec until the first sink must be flushed, -1 if none has
+ * anything buffered, or 0 with interactive set if a terminal has.
+ */
+static int sinksTimeout(bool interactive)
+{
+	int timeout = -1;
+	int t, i;
+
+	for (i = 0; i < g_sink_count; i++) {
+		t = log_output_timeout(&g_sinks[i]->output);
+		if (t > 0 && interactive && g_sinks[i]->output.interactive) {
+			t = 0;
+		}
+		if (t >= 0 && (timeout < 0 || t < timeout)) {
+			timeout = t;
+		}
+	}
+
+	return timeout;
+}
+
+/* returns the sinks taking the entries of the device called name */
+static uint32_t sinksOf(const char* name)
+{
+	uint32_t sinks = 0;
+	int i, j;
 
-    g_out_byte_count = 0;
+	for (i = 0; i < g_sink_count; i++) {
+		for (j = 0; j < g_sinks[i]->buffer_count; j++) {
+			if (!strcmp(g_sinks[i]->buffers[j], name)) {
+				break;
+			}
+		}
+		if (g_sinks[i]->buffer_count == 0 || j < g_sinks[i]->buffer_count) {
+			sinks |= 1u << i;
+		}
+	}
 
+	return sinks;
 }
 
 
@@ -148,7 +521,8 @@ static void processBuffer(struct log_device_t* dev, struct logger_entry *buf)
 	int bytes_written = 0;
 	int err;
 	log_entry entry;
-	char mgs_buf[1024];
+	struct log_sink_t* sink;
+	int i;
 
 	err = log_process_log_buffer(buf, &entry);
 
@@ -156,33 +530,33 @@ static void processBuffer(struct log_device_t* dev, struct logger_entry *buf)
 		goto error;
 	}
 
-	if (log_should_print_line(g_logformat, entry.tag, entry.priority)) {
-		if (false && g_dev_count > 1) {
-			// FIXME
-			mgs_buf[0] = dev->device[0];
-			mgs_buf[1] = ' ';
-			bytes_written = write(g_outfd, mgs_buf, 2);
-			if (bytes_written < 0)
-			{
-				perror("output error");
+	for (i = 0; i < g_sink_count; i++) {
+		sink = g_sinks[i];
+		if (!(dev->sinks & (1u << i)) || !log_should_print_line(sink->format, entry.tag, entry.priority)) {
+			continue;
+		}
+
+		if (g_binary && i == 0) {
+			char record[LOG_BINARY_RECORD_MAX];
+			size_t len;
+
+			if (g_store && log_index_add(&g_index, sink->byte_count, g_binary_writer.last_nsec, buf) < 0) {
+				fprintf(stderr,"Can't malloc segment index\n");
 				exit(-1);
 			}
-		}
+			len = log_binary_encode(&g_binary_writer, record, dev->id, buf);
 
-		bytes_written = log_print_log_line(g_logformat, g_outfd, &entry);
+			bytes_written = log_output_write(&sink->output, record, len);
+		} else {
+			bytes_written = log_output_print_line(&sink->output, sink->format, &entry);
+		}
 
 		if (bytes_written < 0)
 		{
 			perror("output error");
 			exit(-1);
 		}
-	}
-
-	g_out_byte_count += bytes_written;
-
-    if (g_log_rotate_size_kbytes > 0 && (g_out_byte_count / 1024) >= g_log_rotate_size_kbytes)
-	{
-		rotate_logs();
+		sinkWritten(sink, bytes_written);
 	}
 
 error:
@@ -190,207 +564,1785 @@ error:
 	return;
 }
 
-static void chooseFirst(struct log_device_t* dev, struct log_device_t** firstdev)
+/* returns the device holding the oldest queued entry */
+static struct log_device_t* chooseFirst(void)
 {
-	for (*firstdev = NULL; dev != NULL; dev = dev->next) {
-		if (dev->queue != NULL && (*firstdev == NULL || cmp(dev->queue, (*firstdev)->queue) < 0))
-		{
-			*firstdev = dev;
-		}
+	struct log_queue_t* queue = log_merge_first(&g_merge);
+
+	return queue ? (struct log_device_t *)queue->owner : NULL;
+}
+
+/*
+ * returns the device whose oldest entry is safe to print, given that all
+ * devices were drained after drained_at: older than the reorder window
+ * before that, if some device has nothing queued
+ */
+static struct log_device_t* chooseReady(const struct timespec* drained_at)
+{
+	struct log_queue_t* queue;
+	struct timespec mark = *drained_at;
+
+	mark.tv_sec -= g_reorder_msec / 1000;
+	mark.tv_nsec -= (g_reorder_msec % 1000) * 1000000;
+	if (mark.tv_nsec < 0) {
+		mark.tv_sec--;
+		mark.tv_nsec += 1000000000;
 	}
+	queue = log_merge_ready(&g_merge, mark.tv_sec, mark.tv_nsec);
+
+	return queue ? (struct log_device_t *)queue->owner : NULL;
 }
 
-static void maybePrintStart(struct log_device_t* dev) {
-	if (!dev->printed) {
-		dev->printed = true;
-		if (g_dev_count > 1 ) {
-			char buf[1024];
-			snprintf(buf, sizeof(buf), "--------- beginning of %s\n", dev->device);
-			if (write(g_outfd, buf, strlen(buf)) < 0) {
-				perror("output error");
+static void formatBatch(struct log_batch_t* batch)
+{
+	struct log_batch_record_t* record;
+	struct log_batch_text_t* text;
+	log_format* format;
+	log_entry entry;
+	size_t pos = 0;
+	size_t len;
+	char* tail;
+	char* line;
+	int i;
+
+	while ((record = log_batch_next(batch, &pos)) != NULL) {
+		if (record->kind == LOG_BATCH_ENTRY && log_process_log_buffer(&record->entry, &entry) < 0) {
+			continue;
+		}
+		for (i = 0; i < g_sink_count; i++) {
+			if (!(record->texts & (1u << i))) {
+				continue;
+			}
+			text = &batch->text[i];
+			format = g_sinks[i]->format;
+			if (record->kind == LOG_BATCH_TEXT) {
+				len = record->entry.len;
+				line = record->entry.msg;
+			} else {
+				if (!log_should_print_line(format, entry.tag, entry.priority)) {
+					continue;
+				}
+				if (log_batch_reserve(text, LINE_ROOM) < 0) {
+					fprintf(stderr,"Can't malloc batch text\n");
+					exit(-1);
+				}
+				tail = text->buf + text->len;
+				line = log_format_log_line(format, tail, text->size - text->len, &entry, &len);
+				if (line == NULL) {
+					fprintf(stderr,"Can't malloc formatted line\n");
+					exit(-1);
+				}
+				if (line == tail) {
+					text->len += len;
+					continue;
+				}
+			}
+
+			if (log_batch_reserve(text, len) < 0) {
+				fprintf(stderr,"Can't malloc batch text\n");
 				exit(-1);
 			}
+			memcpy(text->buf + text->len, line, len);
+			text->len += len;
+			if (record->kind != LOG_BATCH_TEXT) {
+				free(line);
+			}
 		}
 	}
 }
 
-static void skipNextEntry(struct log_device_t* dev) {
-	maybePrintStart(dev);
-	struct queued_entry_t* entry = dev->queue;
-	dev->queue = entry->next;
-	free(entry);
-}
-
-static void printNextEntry(struct log_device_t* dev)
+static void* formatThread(void* arg)
 {
-	maybePrintStart(dev);
-	processBuffer(dev, &dev->queue->entry);
-	skipNextEntry(dev);
-}
+	struct log_pipe_t* in = &g_format_in[(intptr_t)arg];
+	struct log_pipe_t* out = &g_format_out[(intptr_t)arg];
+	struct log_batch_t* batch;
 
+	while (log_pipe_pop(in, &batch, -1) && batch != NULL) {
+		formatBatch(batch);
+		log_pipe_push(out, batch);
+	}
+	log_pipe_push(out, NULL);
 
-static void read_log_lines(struct log_device_t* devices)
+	return NULL;
+}
+
+static void* writeThread(void* arg)
 {
-	struct log_device_t* dev;
-	int max = 0;
-	int ret;
-	int queued_lines = 0;
-	bool sleep = false; // for exit immediately when log buffer is empty and g_nonblock value is true.
+	struct log_batch_t* batch;
+	unsigned int next = 0;
+	int timeout, i;
+	bool popped;
 
-	int result;
-	fd_set readset;
+	(void)arg;
+	while (1) {
+		// files and pipes are flushed when their oldest line is due,
+		// terminals as soon as the formatters have nothing more
+		pthread_mutex_lock(&g_sinks_lock);
+		timeout = sinksTimeout(true);
+		pthread_mutex_unlock(&g_sinks_lock);
+		popped = log_pipe_pop(&g_format_out[next], &batch, timeout);
+		if (popped && batch == NULL) {
+			break;
+		}
 
-	for (dev=devices; dev; dev = dev->next) {
-		if (dev->fd > max) {
-			max = dev->fd;
+		pthread_mutex_lock(&g_sinks_lock);
+		for (i = 0; i < g_sink_count; i++) {
+			if (!popped) {
+				if (log_output_batch_done(&g_sinks[i]->output) < 0) {
+					perror("output error");
+					exit(-1);
+				}
+			} else if (batch->text[i].len > 0) {
+				writeSink(g_sinks[i], batch->text[i].buf, batch->text[i].len);
+			}
+		}
+		pthread_mutex_unlock(&g_sinks_lock);
+		if (!popped) {
+			continue;
 		}
+		next = (next + 1) % g_format_threads;
+
+		log_batch_reset(batch);
+		log_pipe_push(&g_free_batches, batch);
 	}
 
-	while (1) {
-		do {
-			struct timeval timeout = { 0, 5000 /* 5ms */ }; // If we oversleep it's ok, i.e. ignore EINTR.
-			FD_ZERO(&readset);
-			for (dev=devices; dev; dev = dev->next) {
-				FD_SET(dev->fd, &readset);
-			}
-			result = select(max + 1, &readset, NULL, NULL, sleep ? NULL : &timeout);
-		} while (result == -1 && errno == EINTR);
-
-        if (result >= 0) {
-            for (dev=devices; dev; dev = dev->next) {
-                if (FD_ISSET(dev->fd, &readset)) {
-                    struct queued_entry_t* entry = (struct queued_entry_t *)malloc(sizeof( struct queued_entry_t));
-					if (entry == NULL) {
-						fprintf(stderr,"Can't malloc queued_entry\n");
-						exit(-1);
-					}
-					entry->next = NULL;
-
-                    /* NOTE: driver guarantees we read exactly one full entry */
-                    ret = read(dev->fd, entry->buf, LOGGER_ENTRY_MAX_LEN);
-                    if (ret < 0) {
-                        if (errno == EINTR) {
-                            free(entry);
-                            goto next;
-                        }
-                        if (errno == EAGAIN) {
-                            free(entry);
-                            break;
-                        }
-                        perror("dlogutil read");
-                        exit(EXIT_FAILURE);
-                    }
-                    else if (!ret) {
-                        fprintf(stderr, "read: Unexpected EOF!\n");
-                        exit(EXIT_FAILURE);
-                    }
+	flushSinks();
 
-                    entry->entry.msg[entry->entry.len] = '\0';
+	return NULL;
+}
 
-                    enqueue(dev, entry);
-                    ++queued_lines;
-                }
-            }
+static void startPipeline(void)
+{
+	struct log_batch_t* batch;
+	int batches = BATCHES_PER_THREAD * g_format_threads;
+	intptr_t i;
+
+	g_format_in = (struct log_pipe_t *)calloc(g_format_threads, sizeof(struct log_pipe_t));
+	g_format_out = (struct log_pipe_t *)calloc(g_format_threads, sizeof(struct log_pipe_t));
+	g_formatters = (pthread_t *)calloc(g_format_threads, sizeof(pthread_t));
+	if (g_format_in == NULL || g_format_out == NULL || g_formatters == NULL
+			|| log_pipe_init(&g_free_batches, batches, true) < 0) {
+		fprintf(stderr,"Can't malloc pipeline\n");
+		exit(-1);
+	}
+	// every queue holds all batches, and a NULL, so pushes never wait
+	for (i = 0; i < g_format_threads; i++) {
+		if (log_pipe_init(&g_format_in[i], batches + 1, false) < 0
+				|| log_pipe_init(&g_format_out[i], batches + 1, false) < 0) {
+			fprintf(stderr,"Can't malloc pipeline\n");
+			exit(-1);
+		}
+	}
+	for (i = 0; i < batches; i++) {
+		batch = log_batch_new();
+		if (batch == NULL) {
+			fprintf(stderr,"Can't malloc batch\n");
+			exit(-1);
+		}
+		log_pipe_push(&g_free_batches, batch);
+	}
 
-            if (result == 0) {
-                // we did our short timeout trick and there's nothing new
-                // print everything we have and wait for more data
-                sleep = true;
-                while (true) {
-                    chooseFirst(devices, &dev);
-                    if (dev == NULL) {
-                        break;
-                    }
-                    if (g_tail_lines == 0 || queued_lines <= g_tail_lines) {
-                        printNextEntry(dev);
-                    } else {
-                        skipNextEntry(dev);
-                    }
-                    --queued_lines;
-                }
+	for (i = 0; i < g_format_threads; i++) {
+		if (pthread_create(&g_formatters[i], NULL, formatThread, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(-1);
+		}
+	}
+	if (pthread_create(&g_writer, NULL, writeThread, NULL) != 0) {
+		perror("pthread_create");
+		exit(-1);
+	}
+}
 
-                // the caller requested to just dump the log and exit
-                if (g_nonblock) {
-                    exit(0);
-                }
-            } else {
-                // print all that aren't the last in their list
-                sleep = false;
-                while (g_tail_lines == 0 || queued_lines > g_tail_lines) {
-                    chooseFirst(devices, &dev);
-                    if (dev == NULL || dev->queue->next == NULL) {
-                        break;
-                    }
-                    if (g_tail_lines == 0) {
-                        printNextEntry(dev);
-                    } else {
-                        skipNextEntry(dev);
-                    }
-                    --queued_lines;
-                }
-            }
-        }
-next:
-        ;
-    }
+/* hands the batch being filled to the next formatter */
+static void dispatchBatch(void)
+{
+	if (g_batch == NULL || g_batch->count == 0) {
+		return;
+	}
+	log_pipe_push(&g_format_in[g_dispatch_next], g_batch);
+	g_dispatch_next = (g_dispatch_next + 1) % g_format_threads;
+	g_batch = NULL;
 }
 
+/* waits until everything dispatched is written */
+static void stopPipeline(void)
+{
+	int i;
 
-static int clear_log(int logfd)
+	dispatchBatch();
+	for (i = 0; i < g_format_threads; i++) {
+		log_pipe_push(&g_format_in[(g_dispatch_next + i) % g_format_threads], NULL);
+	}
+	pthread_join(g_writer, NULL);
+	for (i = 0; i < g_format_threads; i++) {
+		pthread_join(g_formatters[i], NULL);
+	}
+}
+
+/*
+ * Waits until everything dispatched is written, and keeps the writer off
+ * the sinks until resumePipeline(), so that they can be changed.
+ */
+static void pausePipeline(void)
 {
-    return ioctl(logfd, LOGGER_FLUSH_LOG);
+	struct log_batch_t* batches[BATCHES_PER_THREAD * 64];
+	int count = BATCHES_PER_THREAD * g_format_threads;
+	int i;
+
+	dispatchBatch();
+	if (g_batch != NULL) {
+		log_pipe_push(&g_free_batches, g_batch);
+		g_batch = NULL;
+	}
+	// batches come back once written: when all are, none is in flight
+	for (i = 0; i < count; i++) {
+		log_pipe_pop(&g_free_batches, &batches[i], -1);
+	}
+	for (i = 0; i < count; i++) {
+		log_pipe_push(&g_free_batches, batches[i]);
+	}
+	pthread_mutex_lock(&g_sinks_lock);
 }
 
-/* returns the total size of the log's ring buffer */
-static int get_log_size(int logfd)
+static void resumePipeline(void)
 {
-    return ioctl(logfd, LOGGER_GET_LOG_BUF_SIZE);
+	pthread_mutex_unlock(&g_sinks_lock);
+}
+
+/*
+ * Returns whether the next entry can be printed: always without -j,
+ * otherwise if the batch being filled has room for it and its markers.
+ */
+static bool readyToPrint(bool wait)
+{
+	if (g_format_threads == 0) {
+		return true;
+	}
+	if (g_batch && LOG_BATCH_SIZE - g_batch->used < BATCH_ROOM) {
+		dispatchBatch();
+	}
+	if (g_batch == NULL && !log_pipe_pop(&g_free_batches, &g_batch, wait ? -1 : 0)) {
+		return false;
+	}
+
+	return true;
+}
+
+/* markers go through the pipeline too, to stay in order with the lines */
+static void emitText(uint32_t sinks, const char* buf, size_t len)
+{
+	union {
+		struct logger_entry entry;
+		char buf[sizeof(struct logger_entry) + 1024];
+	} text;
+	int i;
+
+	if (g_format_threads == 0) {
+		for (i = 0; i < g_sink_count; i++) {
+			if (sinks & (1u << i)) {
+				writeSink(g_sinks[i], buf, len);
+			}
+		}
+		return;
+	}
+
+	if (len > sizeof(text.buf) - sizeof(struct logger_entry)) {
+		len = sizeof(text.buf) - sizeof(struct logger_entry);
+	}
+	memset(&text.entry, 0, sizeof(text.entry));
+	text.entry.len = len;
+	memcpy(text.entry.msg, buf, len);
+	log_batch_add(g_batch, LOG_BATCH_TEXT, sinks, &text.entry);
+}
+
+static void maybePrintStart(struct log_device_t* dev) {
+	uint32_t sinks = dev->sinks;
+	int i;
+
+	if (!dev->printed) {
+		dev->printed = true;
+		// binary captures keep the buffer of each record instead, and
+		// sinks taking a single buffer don't need it
+		for (i = 0; i < g_sink_count; i++) {
+			if (g_sinks[i]->buffer_count == 1) {
+				sinks &= ~(1u << i);
+			}
+		}
+		if (g_dev_count > 1 && !g_binary && sinks) {
+			char buf[1024];
+			snprintf(buf, sizeof(buf), "--------- beginning of %s\n", dev->device);
+			emitText(sinks, buf, strlen(buf));
+		}
+	}
+}
+
+static void printLost(struct log_device_t* dev, struct queued_entry_t* entry) {
+	char buf[128];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "--- %u messages lost from pid %d ---\n",
+			entry->lost, entry->entry.pid);
+	emitText(dev->sinks, buf, len);
+}
+
+static void printDropped(struct log_device_t* dev) {
+	char buf[1024];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "--- dropped %lu records of %s ---\n",
+			dev->dropped_unreported, dev->device);
+	emitText(dev->sinks, buf, len);
+	dev->dropped_unreported = 0;
+}
+
+/* prints the drops of every device, ahead of what was queued with them */
+static void reportDropped(struct log_device_t* devices, bool wait) {
+	struct log_device_t* dev;
+
+	for (dev = devices; dev && !g_binary; dev = dev->next) {
+		if (dev->dropped_unreported) {
+			if (!readyToPrint(wait)) {
+				return;
+			}
+			printDropped(dev);
+		}
+	}
+}
+
+static void printLossSummary(struct log_device_t* devices) {
+	struct log_device_t* dev;
+
+	for (dev = devices; dev; dev = dev->next) {
+		if (dev->lost) {
+			fprintf(stderr, "%s: %lu messages lost\n", dev->device, dev->lost);
+		}
+		if (dev->dropped) {
+			fprintf(stderr, "%s: %lu records dropped\n", dev->device, dev->dropped);
+		}
+	}
+}
+
+static uint64_t dedup_hash(const log_entry* entry)
+{
+	uint64_t hash = 14695981039346656037ULL;	// FNV-1a
+	const unsigned char* p;
+	size_t i;
+
+	for (p = (const unsigned char *)entry->tag; ; p++) {
+		hash = (hash ^ *p) * 1099511628211ULL;
+		if (*p == '\0') {
+			break;
+		}
+	}
+	p = (const unsigned char *)entry->message;
+	for (i = 0; i < entry->messageLen; i++) {
+		hash = (hash ^ p[i]) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static void printRepeats(struct dedup_state_t* state)
+{
+	char buf[128];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "--- last message from pid %d repeated %u times over %lld ms ---\n",
+			state->pid, state->repeats, (long long)(state->last_nsec - state->first_nsec) / 1000000);
+	emitText(state->sinks, buf, len);
+	state->repeats = 0;
+	g_dedups.pending--;
+}
+
+/*
+ * Reports the repeats of every window that ended before due_nsec, or all
+ * of them with INT64_MAX. Returns false if it ran out of batches first.
+ */
+static bool reportRepeats(int64_t due_nsec, bool wait)
+{
+	struct dedup_state_t* state;
+	int64_t next = INT64_MAX;
+	int64_t end;
+	unsigned int i;
+
+	if (g_dedups.pending == 0 || due_nsec < g_dedups.due_nsec) {
+		return true;
+	}
+	for (i = 0; i < g_dedups.size && g_dedups.pending > 0; i++) {
+		state = &g_dedups.slots[i];
+		if (state->repeats == 0) {
+			continue;
+		}
+		end = state->first_nsec + (int64_t)g_dedup_msec * 1000000;
+		if (end > due_nsec) {
+			next = end < next ? end : next;
+			continue;
+		}
+		if (!readyToPrint(wait)) {
+			return false;
+		}
+		printRepeats(state);
+	}
+	g_dedups.due_nsec = next;
+
+	return true;
+}
+
+static struct dedup_state_t* dedup_lookup(struct dedup_table_t* table, int32_t pid)
+{
+	unsigned int i, mask;
+	struct dedup_state_t* old;
+	unsigned int old_size;
+
+	if (table->used * 4 >= table->size * 3) {
+		old = table->slots;
+		old_size = table->size;
+		if (old_size >= DEDUP_TABLE_MAX_SIZE) {
+			// too many writers came and went: report and forget them all
+			reportRepeats(INT64_MAX, true);
+			memset(old, 0, old_size * sizeof(*old));
+			table->used = 0;
+		} else {
+			table->size = old_size ? old_size * 2 : DEDUP_TABLE_MIN_SIZE;
+			table->slots = (struct dedup_state_t *)calloc(table->size, sizeof(*old));
+			if (table->slots == NULL) {
+				fprintf(stderr,"Can't malloc dedup table\n");
+				exit(-1);
+			}
+			table->used = 0;
+			for (i = 0; i < old_size; i++) {
+				if (old[i].pid) {
+					*dedup_lookup(table, old[i].pid) = old[i];
+				}
+			}
+			free(old);
+		}
+	}
+
+	mask = table->size - 1;
+	for (i = ((uint32_t)pid * 2654435761u) & mask; ; i = (i + 1) & mask) {
+		struct dedup_state_t* slot = &table->slots[i];
+		if (slot->pid == 0) {
+			slot->pid = pid;
+			slot->priority = -1;
+			slot->hash = 0;
+			slot->repeats = 0;
+			table->used++;
+			return slot;
+		}
+		if (slot->pid == pid) {
+			return slot;
+		}
+	}
+}
+
+/*
+ * Returns whether buf repeats the last line printed for its pid within
+ * the -u window, and counts it if so. Otherwise the repeats of that line
+ * are reported, since buf ends them.
+ */
+static bool isRepeat(struct log_device_t* dev, struct logger_entry* buf)
+{
+	log_entry entry;
+	struct dedup_state_t* state;
+	uint32_t sinks = 0;
+	int i;
+	int64_t nsec = (int64_t)buf->sec * 1000000000 + buf->nsec;
+	int64_t end;
+	uint64_t hash;
+
+	// filtered out lines don't break a run of repeats
+	if (buf->pid == 0 || log_process_log_buffer(buf, &entry) < 0) {
+		return false;
+	}
+	for (i = 0; i < g_sink_count; i++) {
+		if ((dev->sinks & (1u << i)) && log_should_print_line(g_sinks[i]->format, entry.tag, entry.priority)) {
+			sinks |= 1u << i;
+		}
+	}
+	if (sinks == 0) {
+		return false;
+	}
+	hash = dedup_hash(&entry);
+	state = dedup_lookup(&g_dedups, buf->pid);
+
+	if (state->hash == hash && state->priority == (int)entry.priority && state->sinks == sinks
+			&& nsec - state->first_nsec < (int64_t)g_dedup_msec * 1000000) {
+		end = state->first_nsec + (int64_t)g_dedup_msec * 1000000;
+		if (state->repeats++ == 0 && (g_dedups.pending++ == 0 || end < g_dedups.due_nsec)) {
+			g_dedups.due_nsec = end;
+		}
+		state->last_nsec = nsec;
+		return true;
+	}
+
+	if (state->repeats > 0) {
+		printRepeats(state);
+	}
+	state->hash = hash;
+	state->priority = entry.priority;
+	state->sinks = sinks;
+	state->first_nsec = nsec;
+	state->last_nsec = nsec;
+
+	return false;
+}
+
+/* prints buf, unless it is a repeat */
+static void emitEntry(struct log_device_t* dev, struct logger_entry* buf)
+{
+	if (g_dedup_msec > 0 && isRepeat(dev, buf)) {
+		return;
+	}
+	if (g_format_threads > 0) {
+		log_batch_add(g_batch, LOG_BATCH_ENTRY, dev->sinks, buf);
+	} else {
+		processBuffer(dev, buf);
+	}
+}
+
+static void holdEntry(struct log_device_t* dev, struct logger_entry* buf)
+{
+	struct log_device_t** devs;
+	int i;
+
+	if (dev->id >= g_window_dev_count) {
+		devs = (struct log_device_t **)realloc(g_window_devs, (dev->id + 1) * sizeof(*devs));
+		if (devs == NULL) {
+			fprintf(stderr,"Can't malloc window\n");
+			exit(-1);
+		}
+		for (i = g_window_dev_count; i <= dev->id; i++) {
+			devs[i] = NULL;
+		}
+		g_window_devs = devs;
+		g_window_dev_count = dev->id + 1;
+	}
+	g_window_devs[dev->id] = dev;
+	log_window_add(&g_window, dev->id, buf);
+}
+
+/*
+ * Prints the window behind a trigger at nsec, unless the one before is
+ * still printing everything, and prints everything up to g_post_msec
+ * after it.
+ */
+static void fireTrigger(const char* reason, int64_t nsec)
+{
+	static union {
+		unsigned char buf[LOGGER_ENTRY_MAX_LEN + 1] __attribute__((aligned(4)));
+		struct logger_entry entry __attribute__((aligned(4)));
+	} held;
+	struct log_device_t* dev;
+	uint32_t sinks = (1u << g_sink_count) - 1;
+	char buf[1024];
+	int buffer, len;
+
+	if (nsec >= g_post_until_nsec) {
+		// the binary capture has no room for markers
+		if (g_binary) {
+			sinks &= ~1u;
+		}
+		readyToPrint(true);
+		len = snprintf(buf, sizeof(buf), "--- trigger: %s, %u records before it ---\n",
+				reason, g_window.count);
+		emitText(sinks, buf, len);
+		while (log_window_take(&g_window, &buffer, &held.entry)) {
+			dev = g_window_devs[buffer];
+			readyToPrint(true);
+			maybePrintStart(dev);
+			emitEntry(dev, &held.entry);
+		}
+	}
+	nsec += (int64_t)g_post_msec * 1000000;
+	if (nsec > g_post_until_nsec) {
+		g_post_until_nsec = nsec;
+	}
+}
+
+/* whether the len bytes at msg, not terminated, contain text */
+static bool hasText(const char* msg, size_t len, const char* text)
+{
+	size_t text_len = strlen(text);
+	const char* p;
+
+	while (len >= text_len && (p = (const char *)memchr(msg, text[0], len - text_len + 1)) != NULL) {
+		if (!memcmp(p, text, text_len)) {
+			return true;
+		}
+		len -= p + 1 - msg;
+		msg = p + 1;
+	}
+
+	return false;
+}
+
+/*
+ * Returns whether buf is to be printed rather than held in the window:
+ * if it is a trigger, which prints the window first, or comes after one
+ * by less than g_post_msec.
+ */
+static bool isTriggered(struct logger_entry* buf)
+{
+	static const char pri_chars[] = "??VDIWEF";
+	log_entry entry;
+	char reason[128];
+	int64_t nsec = (int64_t)buf->sec * 1000000000 + buf->nsec;
+
+	if (log_process_log_buffer(buf, &entry) < 0) {
+		return nsec < g_post_until_nsec;
+	}
+	if (log_should_print_line(g_triggers, entry.tag, entry.priority)) {
+		snprintf(reason, sizeof(reason), "%c/%s",
+				(unsigned)entry.priority < sizeof(pri_chars) - 1 ? pri_chars[entry.priority] : '?', entry.tag);
+	} else if (g_trigger_match && hasText(entry.message, entry.messageLen, g_trigger_match)) {
+		snprintf(reason, sizeof(reason), "'%s' from %s", g_trigger_match, entry.tag);
+	} else {
+		return nsec < g_post_until_nsec;
+	}
+	fireTrigger(reason, nsec);
+	readyToPrint(true);
+
+	return true;
+}
+
+static void dropNextEntry(struct log_device_t* dev) {
+	struct queued_entry_t* entry = log_merge_pop(&g_merge, &dev->queue);
+	log_arena_free(&g_arena, entry);
+}
+
+static void skipNextEntry(struct log_device_t* dev) {
+	maybePrintStart(dev);
+	dropNextEntry(dev);
+}
+
+static void printNextEntry(struct log_device_t* dev)
+{
+	// held entries take no loss report along; the summary still counts it
+	if (g_window_kbytes > 0 && !isTriggered(&dev->queue.head->entry)) {
+		holdEntry(dev, &dev->queue.head->entry);
+		dropNextEntry(dev);
+		return;
+	}
+	maybePrintStart(dev);
+	if (dev->queue.head->lost && !g_binary) {
+		printLost(dev, dev->queue.head);
+	}
+	emitEntry(dev, &dev->queue.head->entry);
+	dropNextEntry(dev);
+}
+
+
+static int clear_log(int logfd)
+{
+    return ioctl(logfd, LOGGER_FLUSH_LOG);
+}
+
+/* returns the total size of the log's ring buffer */
+static int get_log_size(int logfd)
+{
+    return ioctl(logfd, LOGGER_GET_LOG_BUF_SIZE);
+}
+
+/* returns the readable size of the log's ring buffer (that is, amount of the log consumed) */
+static int get_log_readable_size(int logfd)
+{
+    return ioctl(logfd, LOGGER_GET_LOG_LEN);
+}
+
+/* frees the entry after prev in dev, or its head if prev is NULL */
+static void dropEntry(struct log_device_t* dev, struct queued_entry_t* prev)
+{
+	log_arena_free(&g_arena, log_merge_remove(&g_merge, &dev->queue, prev));
+	dev->dropped++;
+	dev->dropped_unreported++;
+}
+
+static int entryPriority(const struct queued_entry_t* entry)
+{
+	return entry->entry.len > 0 ? (unsigned char)entry->entry.msg[0] : DLOG_UNKNOWN;
+}
+
+static size_t queueLowWater(void)
+{
+	return g_queue_budget - g_queue_budget / 8;
+}
+
+static bool overBudget(size_t limit)
+{
+	// a few live entries pin whole chunks, so the chunks held count too
+	return g_arena.live_bytes > limit
+		|| log_arena_footprint(&g_arena) > 2 * limit + (LOG_ARENA_MAX_SPARE + 1) * LOG_ARENA_CHUNK_SIZE;
+}
+
+/*
+ * Applies the --drop policy once the queued entries go over the budget.
+ * Returns how many entries were dropped.
+ */
+static int enforceBudget(struct log_device_t* devices)
+{
+	struct log_device_t* dev;
+	struct queued_entry_t* prev;
+	struct queued_entry_t* entry;
+	size_t low = queueLowWater();
+	int prio, dropped = 0;
+
+	if (g_queue_budget == 0 || !overBudget(g_queue_budget)) {
+		return 0;
+	}
+	if (g_drop_policy == DROP_PAUSE) {
+		g_paused = true;
+		return 0;
+	}
+
+	if (g_drop_policy == DROP_PRIORITY) {
+		for (prio = DLOG_VERBOSE; prio < DLOG_SILENT && g_arena.live_bytes > low; prio++) {
+			for (dev = devices; dev && g_arena.live_bytes > low; dev = dev->next) {
+				prev = NULL;
+				entry = dev->queue.head;
+				while (entry && g_arena.live_bytes > low) {
+					if (entryPriority(entry) <= prio) {
+						entry = entry->next;
+						dropEntry(dev, prev);
+						dropped++;
+					} else {
+						prev = entry;
+						entry = entry->next;
+					}
+				}
+			}
+		}
+	}
+
+	// entries were read in about this order, so this frees whole chunks
+	while (overBudget(low) && (dev = chooseFirst()) != NULL) {
+		dropEntry(dev, NULL);
+		dropped++;
+	}
+
+	return dropped;
+}
+
+/* stops or resumes waiting for the devices while reading is paused */
+static void setReading(int epfd, struct log_device_t* devices, bool reading)
+{
+	struct log_device_t* dev;
+	struct epoll_event ev;
+
+	for (dev = devices; dev; dev = dev->next) {
+		if (!dev->input.pollable || dev->ended) {
+			continue;
+		}
+		ev.events = reading ? EPOLLIN : 0;
+		ev.data.ptr = dev;
+		if (epoll_ctl(epfd, EPOLL_CTL_MOD, dev->input.fd, &ev) < 0) {
+			perror("epoll_ctl");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/*
+ * Reads every entry currently in dev. The device is non-blocking, so this
+ * returns once the driver has nothing more, and a dump can tell an empty
+ * ring from a quiet one without waiting. A dump also stops once it read
+ * what the ring held when it started, but reads other sources to their
+ * end. Reading stops early while the queue budget has paused it.
+ */
+static void drainDevice(struct log_device_t* dev, struct log_device_t* devices, int* queued_lines)
+{
+	struct queued_entry_t* entry;
+	struct pollfd pfd;
+	unsigned int lost;
+	int64_t nsec;
+	int ret;
+
+	while (!g_paused && dev->dump_left != 0 && !dev->ended) {
+		ret = log_input_read(&dev->input, &g_readbuf.entry);
+		if (ret < 0) {
+			if (errno == EAGAIN && g_nonblock && dev->input.kind != LOG_INPUT_DEVICE) {
+				pfd.fd = dev->input.fd;
+				pfd.events = POLLIN;
+				poll(&pfd, 1, -1);
+				continue;
+			}
+			if (errno == EAGAIN) {
+				return;
+			}
+			fprintf(stderr, "%s: %s\n", dev->device, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		else if (!ret) {
+			if (dev->input.kind != LOG_INPUT_DEVICE) {
+				// closing it takes it out of the epoll set too
+				dev->ended = true;
+				log_input_close(&dev->input);
+				log_merge_wait(&g_merge, &dev->queue, false);
+				return;
+			}
+			fprintf(stderr, "read: Unexpected EOF!\n");
+			exit(EXIT_FAILURE);
+		}
+		if (dev->dump_left > 0) {
+			dev->dump_left -= ret < dev->dump_left ? ret : dev->dump_left;
+		}
+
+		lost = seq_check(dev, &g_readbuf.entry);
+		entry = log_arena_copy(&g_arena, &g_readbuf.entry);
+		if (entry == NULL) {
+			// out of memory is one more reason to drop
+			dev->dropped++;
+			dev->dropped_unreported++;
+			continue;
+		}
+		entry->lost = lost;
+		// SIGUSR1 comes no earlier than the newest entry read, which
+		// for a replay of logs from another clock can be after now
+		nsec = (int64_t)entry->entry.sec * 1000000000 + entry->entry.nsec;
+		if (nsec > g_newest_nsec) {
+			g_newest_nsec = nsec;
+		}
+
+		log_merge_push(&g_merge, &dev->queue, entry);
+		++*queued_lines;
+		*queued_lines -= enforceBudget(devices);
+
+		// the newest g_tail_lines of all devices are among the newest
+		// g_tail_lines of each, so older ones go back to the arena now
+		if (g_tail_lines > 0 && dev->queue.count > (size_t)g_tail_lines) {
+			dropNextEntry(dev);
+			--*queued_lines;
+		}
+	}
+}
+
+/* prints everything queued, or only the last g_tail_lines of it */
+static void printAll(int* queued_lines)
+{
+	struct log_device_t* dev;
+
+	while (readyToPrint(true) && (dev = chooseFirst()) != NULL) {
+		if (g_tail_lines == 0 || *queued_lines <= g_tail_lines) {
+			printNextEntry(dev);
+		} else {
+			skipNextEntry(dev);
+		}
+		--*queued_lines;
+	}
+}
+
+/*
+ * Returns how long the oldest queued entry still has to wait for the
+ * reorder window, in msec, or -1 if nothing is queued.
+ */
+static int nextReadyTimeout(const struct timespec* now)
+{
+	struct log_device_t* dev = chooseFirst();
+	long long ms;
+
+	if (dev == NULL) {
+		return -1;
+	}
+	ms = ((long long)dev->queue.head->entry.sec - now->tv_sec) * 1000
+		+ (dev->queue.head->entry.nsec - now->tv_nsec) / 1000000
+		+ g_reorder_msec + 1;
+
+	return ms < 0 ? 0 : ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
+/*
+ * Returns how long until the first -u window ends, in msec, give or take
+ * the reorder window for its late repeats, or -1 if none has repeats.
+ */
+static int nextRepeatsTimeout(const struct timespec* now)
+{
+	long long ms;
+
+	if (g_dedups.pending == 0) {
+		return -1;
+	}
+	ms = (g_dedups.due_nsec - ((int64_t)now->tv_sec * 1000000000 + now->tv_nsec)) / 1000000
+		+ g_reorder_msec + 1;
+
+	return ms < 0 ? 0 : ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
+/* returns the device standing in for the capture buffer named name */
+static struct log_device_t* binaryDevice(struct log_device_t** devices, const char* name)
+{
+	struct log_device_t** dev;
+
+	for (dev = devices; *dev; dev = &(*dev)->next) {
+		if (!strcmp((*dev)->device, name)) {
+			return *dev;
+		}
+	}
+	*dev = new_log_device(strdup(name));
+	(*dev)->sinks = sinksOf(name);
+	g_dev_count++;
+
+	return *dev;
+}
+
+/* forgets the writers of dev, when records are skipped on purpose */
+static void seq_reset(struct log_device_t* dev)
+{
+	if (dev->seqs.slots) {
+		memset(dev->seqs.slots, 0, dev->seqs.size * sizeof(struct seq_state_t));
+	}
+	dev->seqs.used = 0;
+}
+
+static bool matchesQuery(const struct logger_entry* buf)
+{
+	int64_t nsec = (int64_t)buf->sec * 1000000000 + buf->nsec;
+
+	if (nsec < g_since_nsec || nsec > g_until_nsec) {
+		return false;
+	}
+	if (g_query_pid >= 0 && buf->pid != g_query_pid) {
+		return false;
+	}
+	if (g_query_tag && (buf->len < 2 || strncmp(buf->msg + 1, g_query_tag, buf->len - 1))) {
+		return false;
+	}
+
+	return true;
+}
+
+/* returns whether the index rules out anything in it matching the query */
+static bool skipByIndex(const struct log_index_t* idx)
+{
+	return idx->block_count == 0
+		|| idx->max_nsec < g_since_nsec || idx->min_nsec > g_until_nsec
+		|| (g_query_tag && !log_index_has_tag(idx, g_query_tag))
+		|| (g_query_pid >= 0 && !log_index_has_pid(idx, g_query_pid));
+}
+
+/* prints the records of reader up to where it ends, that match the query */
+static int printBinaryRecords(struct log_binary_reader_t* reader, struct log_device_t** map)
+{
+	struct queued_entry_t* entry;
+	struct log_device_t* dev;
+	int buffer, ret;
+
+	unsigned lost;
+
+	while ((ret = log_binary_read(reader, &buffer, &g_readbuf.entry)) > 0) {
+		// records that don't match still count for loss detection, but
+		// lost messages are only reported next to ones that do
+		dev = map[buffer];
+		lost = seq_check(dev, &g_readbuf.entry);
+		if (!matchesQuery(&g_readbuf.entry)) {
+			continue;
+		}
+		entry = log_arena_copy(&g_arena, &g_readbuf.entry);
+		if (entry == NULL) {
+			fprintf(stderr,"Can't malloc queued_entry\n");
+			exit(-1);
+		}
+		entry->lost = lost;
+		log_merge_push(&g_merge, &dev->queue, entry);
+		readyToPrint(true);
+		printNextEntry(dev);
+	}
+
+	return ret;
+}
+
+/*
+ * Prints one segment of a capture. An indexed segment is skipped when
+ * nothing in it can match, and otherwise only its blocks that can are
+ * read.
+ */
+static void read_binary_file(const char* path, struct log_device_t** devices)
+{
+	static struct log_binary_reader_t reader;
+	struct log_device_t* map[LOG_BINARY_MAX_BUFFERS];
+	struct log_index_t idx;
+	struct log_index_block_t* block;
+	off_t index_offset;
+	bool skip;
+	size_t i, j;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || log_binary_open(&reader, fd) < 0) {
+		fprintf(stderr, "Unable to read binary capture '%s': %s\n",
+			path, strerror(errno));
+		exit(-1);
+	}
+	for (i = 0; i < (size_t)reader.buffer_count; i++) {
+		map[i] = binaryDevice(devices, reader.buffers[i]);
+	}
+	// records are then decoded straight from the page cache; a file that
+	// can't be mapped is read as before
+	log_binary_map(&reader);
+
+	if (log_index_load(&idx, fd, &index_offset) < 0) {
+		// still being written, or cut short: read all of it
+		ret = printBinaryRecords(&reader, map);
+	} else {
+		ret = 0;
+		skip = skipByIndex(&idx);
+		for (j = 0; skip && j < (size_t)reader.buffer_count; j++) {
+			seq_reset(map[j]);
+		}
+		for (i = 0; !skip && i < idx.block_count && ret >= 0; i++) {
+			block = &idx.blocks[i];
+			if (block->max_nsec < g_since_nsec || block->min_nsec > g_until_nsec) {
+				continue;
+			}
+			if (log_binary_tell(&reader) != block->offset) {
+				if (log_binary_seek(&reader, block->offset, block->base_nsec) < 0) {
+					ret = -1;
+					break;
+				}
+				// the records skipped are not lost
+				for (j = 0; j < (size_t)reader.buffer_count; j++) {
+					seq_reset(map[j]);
+				}
+			}
+			reader.end = i + 1 < idx.block_count ? idx.blocks[i + 1].offset : index_offset;
+			ret = printBinaryRecords(&reader, map);
+		}
+		log_index_free(&idx);
+	}
+
+	if (g_format_threads == 0) {
+		flushSinks();
+	}
+	if (ret < 0) {
+		if (g_format_threads > 0) {
+			stopPipeline();
+		}
+		fprintf(stderr, "%s: damaged record, stopping\n", path);
+		exit(-1);
+	}
+	log_binary_close(&reader);
+	close(fd);
+}
+
+/* prints a capture written with -B, rotated segments first */
+static void read_binary_capture(const char* path)
+{
+	struct log_device_t* devices = NULL;
+	struct log_segment_t* segments = NULL;
+	struct log_segment_t* seg;
+
+	if (g_format_threads > 0) {
+		startPipeline();
+	}
+	log_rotate_list(path, &segments);
+	for (seg = segments; seg; seg = seg->next) {
+		if (seg->compressed) {
+			fprintf(stderr, "%s%s: compressed, skipped\n", seg->name, LOG_ROTATE_SUFFIX);
+			continue;
+		}
+		read_binary_file(seg->name, &devices);
+	}
+	log_rotate_free_list(segments);
+
+	read_binary_file(path, &devices);
+	reportRepeats(INT64_MAX, true);
+	if (g_format_threads > 0) {
+		stopPipeline();
+	}
+	printLossSummary(devices);
+}
+
+static int setup_output(struct log_sink_t* sink)
+{
+    bool binary = g_binary && sink == g_sinks[0];
+    int fd;
+
+    if (sink->ring_kbytes > 0) {
+        if (log_ring_open(&sink->ring, sink->filename, (size_t)sink->ring_kbytes * 1024) < 0) {
+            perror ("couldn't open ring file");
+            return -1;
+        }
+        // copying into the mapping is cheap: do it after every batch
+        if (log_output_init(&sink->output, -1, LOG_OUTPUT_BUF_SIZE, 0) < 0) {
+            fprintf(stderr,"Can't malloc output buffer\n");
+            exit(-1);
+        }
+        sink->output.ring = &sink->ring;
+        return 0;
+    }
+
+    if (sink->filename == NULL) {
+        fd = STDOUT_FILENO;
+
+    } else {
+        struct stat statbuf;
+
+        fd = open_logfile (sink->filename);
+
+        if (fd < 0) {
+            perror ("couldn't open output file");
+            return -1;
+        }
+
+        fstat(fd, &statbuf);
+
+        sink->byte_count = statbuf.st_size;
+
+        // a capture can't be appended to: it has a header of its own
+        if (binary && ftruncate(fd, 0) == 0) {
+            sink->byte_count = 0;
+        }
+    }
+
+    if (log_output_init(&sink->output, fd, LOG_OUTPUT_BUF_SIZE, LOG_OUTPUT_FLUSH_MSEC) < 0) {
+        fprintf(stderr,"Can't malloc output buffer\n");
+        exit(-1);
+    }
+
+    // only files can, and without io_uring the output stays synchronous
+    if (g_io_uring && log_output_use_uring(&sink->output) < 0 && errno != EINVAL) {
+        static bool warned = false;
+
+        if (!warned) {
+            fprintf(stderr, "io_uring unavailable, writing synchronously: %s\n", strerror(errno));
+            warned = true;
+        }
+    }
+
+    if (binary) {
+        startBinaryFile();
+    }
+
+    if (sink->rotate_kbytes > 0) {
+        // rotated logs may take up as much as <count> uncompressed ones would
+        // captures stay uncompressed, so that -F can read them back and,
+        // if indexed, seek in them
+        if (log_rotate_start(&sink->rotate, sink->filename,
+                    (off_t)sink->max_rotated * sink->rotate_kbytes * 1024, !binary) < 0) {
+            perror("couldn't start log rotation");
+            exit(-1);
+        }
+    }
+
+    return 0;
+}
+
+static int set_log_format(log_format* p_format, const char * formatString)
+{
+	static log_print_format format;
+
+	format = log_format_from_string(formatString);
+
+	if (format == FORMAT_OFF) {
+		// FORMAT_OFF means invalid string
+		return -1;
+	}
+
+	log_set_print_format(p_format, format);
+
+	return 0;
+}
+
+static struct log_sink_t* newSink(void)
+{
+	struct log_sink_t* sink;
+
+	sink = (struct log_sink_t *)calloc(1, sizeof(struct log_sink_t));
+	if (sink == NULL || (sink->format = log_format_new()) == NULL) {
+		fprintf(stderr,"Can't malloc sink\n");
+		exit(-1);
+	}
+	sink->max_rotated = DEFAULT_MAX_ROTATED_LOGS;
+
+	return sink;
+}
+
+/* frees a sink whose output was never set up */
+static void freeSink(struct log_sink_t* sink)
+{
+	if (sink->format) {
+		log_format_free(sink->format);
+	}
+	free(sink->buffers);
+	free(sink->filename);
+	free(sink);
+}
+
+/* stops writing to sink, and frees it */
+static void closeSink(struct log_sink_t* sink)
+{
+	if (log_output_close(&sink->output) < 0) {
+		perror("output error");
+	}
+	if (sink->output.ring) {
+		log_ring_close(&sink->ring);
+	} else if (sink->output.fd != STDOUT_FILENO) {
+		close(sink->output.fd);
+	}
+	if (sink->rotate_kbytes > 0) {
+		log_rotate_stop(&sink->rotate);
+	}
+	freeSink(sink);
+}
+
+static void addBuffer(char*** buffers, int* count, char* name)
+{
+	char** grown;
+
+	grown = (char **)realloc(*buffers, (*count + 1) * sizeof(char *));
+	if (grown == NULL) {
+		fprintf(stderr,"Can't malloc sink\n");
+		exit(-1);
+	}
+	*buffers = grown;
+	(*buffers)[(*count)++] = name;
+}
+
+/*
+ * Returns a sink set up from spec: the -b, -f, -r, -n, -m, -v and -s
+ * options and filterspecs dlogutil takes for its own output, separated by
+ * spaces. Errors are reported with where the spec came from, and return
+ * NULL. The output is not opened yet.
+ */
+static struct log_sink_t* parseSink(const char* spec, const char* where)
+{
+	struct log_sink_t* sink = newSink();
+	char* args[64];
+	char* copy;
+	char* save;
+	char* arg;
+	char* name;
+	int count = 0;
+	bool has_format = false;
+	bool has_filter = false;
+	int ret, i;
+
+	copy = strdup(spec);
+	if (copy == NULL) {
+		fprintf(stderr,"Can't malloc sink\n");
+		exit(-1);
+	}
+	args[count++] = (char *)where;
+	for (arg = strtok_r(copy, " \t\r\n", &save); arg != NULL; arg = strtok_r(NULL, " \t\r\n", &save)) {
+		// one slot is left for the NULL ending them
+		if (count == sizeof(args) / sizeof(args[0]) - 1) {
+			fprintf(stderr,"%s: too many arguments in sink spec\n", where);
+			goto bad;
+		}
+		args[count++] = arg;
+	}
+	args[count] = NULL;
+
+	optind = 0;
+	while ((ret = getopt(count, args, "b:f:r:n:m:v:s")) >= 0) {
+		switch (ret) {
+			case 'b':
+				name = log_input_name(optarg);
+				if (name == NULL) {
+					fprintf(stderr,"Can't malloc sink\n");
+					exit(-1);
+				}
+				addBuffer(&sink->buffers, &sink->buffer_count, name);
+			break;
+
+			case 'f':
+				free(sink->filename);
+				sink->filename = strdup(optarg);
+				if (sink->filename == NULL) {
+					fprintf(stderr,"Can't malloc sink\n");
+					exit(-1);
+				}
+			break;
+
+			case 'r':
+			case 'n':
+			case 'm':
+				if (!isdigit(optarg[0]) || (ret == 'm' && atoi(optarg) <= 0)) {
+					fprintf(stderr,"%s: invalid parameter to -%c\n", where, ret);
+					goto bad;
+				}
+				*(ret == 'r' ? &sink->rotate_kbytes : ret == 'n' ? &sink->max_rotated : &sink->ring_kbytes) = atoi(optarg);
+			break;
+
+			case 'v':
+				if (set_log_format(sink->format, optarg) < 0) {
+					fprintf(stderr,"%s: invalid parameter to -v\n", where);
+					goto bad;
+				}
+				has_format = true;
+			break;
+
+			case 's':
+				log_add_filter_rule(sink->format, "*:s");
+			break;
+
+			default:
+				// getopt told what is wrong
+				goto bad;
+			break;
+		}
+	}
+
+	if ((sink->rotate_kbytes != 0 || sink->ring_kbytes != 0) && sink->filename == NULL) {
+		fprintf(stderr,"%s: -r and -m require -f\n", where);
+		goto bad;
+	}
+	if (sink->rotate_kbytes != 0 && sink->ring_kbytes != 0) {
+		fprintf(stderr,"%s: -m can't be used with -r\n", where);
+		goto bad;
+	}
+	if (!has_format) {
+		set_log_format(sink->format, "brief");
+	}
+	for (i = optind; i < count; i++) {
+		if (log_add_filter_string(sink->format, args[i]) < 0) {
+			fprintf(stderr,"%s: invalid filter expression '%s'\n", where, args[i]);
+			goto bad;
+		}
+		has_filter = true;
+	}
+	if (!has_filter) {
+		log_add_filter_string(sink->format, "*:d");
+	}
+	// without -b, a sink takes the buffers given outside of it
+	for (i = 0; sink->buffer_count == 0 && i < g_default_buffer_count; i++) {
+		addBuffer(&sink->buffers, &sink->buffer_count, g_default_buffers[i]);
+	}
+	free(copy);
+
+	return sink;
+
+bad:
+	free(copy);
+	freeSink(sink);
+	return NULL;
+}
+
+/*
+ * Reads the sinks of a -C file, one per line, each given like the argument
+ * of --sink. Blank lines and lines starting with # are skipped. Returns
+ * how many sinks there are, or -1 after reporting what is wrong.
+ */
+static int loadConfig(const char* path, struct log_sink_t** sinks)
+{
+	FILE* fp;
+	char* line = NULL;
+	size_t size = 0;
+	char where[PATH_MAX + 16];
+	char* p;
+	int count = 0;
+	int lineno = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	while (getline(&line, &size, fp) >= 0) {
+		lineno++;
+		for (p = line; isspace((unsigned char)*p); p++)
+			;
+		if (*p == '\0' || *p == '#') {
+			continue;
+		}
+		snprintf(where, sizeof(where), "%s:%d", path, lineno);
+		if (count == MAX_SINKS) {
+			fprintf(stderr, "%s: too many sinks, at most %d\n", where, MAX_SINKS);
+			goto bad;
+		}
+		if ((sinks[count] = parseSink(p, where)) == NULL) {
+			goto bad;
+		}
+		count++;
+	}
+	if (count == 0) {
+		fprintf(stderr, "%s: no sinks\n", path);
+		goto bad;
+	}
+	free(line);
+	fclose(fp);
+
+	return count;
+
+bad:
+	while (count > 0) {
+		freeSink(sinks[--count]);
+	}
+	free(line);
+	fclose(fp);
+	return -1;
+}
+
+/*
+ * Adds the devices the sinks read that *devices doesn't have yet, unopened.
+ * The sinks then share the names of the devices.
+ */
+static void addSinkDevices(struct log_sink_t** sinks, int count, struct log_device_t** devices)
+{
+	struct log_device_t** dev;
+	char* name;
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < sinks[i]->buffer_count; j++) {
+			name = sinks[i]->buffers[j];
+			for (dev = devices; *dev; dev = &(*dev)->next) {
+				if (!strcmp((*dev)->device, name)) {
+					break;
+				}
+			}
+			if (*dev == NULL) {
+				*dev = new_log_device(name);
+				g_dev_count++;
+			} else if ((*dev)->device != name) {
+				sinks[i]->buffers[j] = (*dev)->device;
+				free(name);
+			}
+		}
+	}
+}
+
+static bool sameOutput(const struct log_sink_t* a, const struct log_sink_t* b)
+{
+	if (a->ring_kbytes != b->ring_kbytes) {
+		return false;
+	}
+	return a->filename == NULL ? b->filename == NULL
+		: b->filename != NULL && !strcmp(a->filename, b->filename);
+}
+
+/* gives sink the settings of from, which is freed, but keeps its output */
+static void adoptSink(struct log_sink_t* sink, struct log_sink_t* from)
+{
+	log_format* format = sink->format;
+	char** buffers = sink->buffers;
+	off_t budget = (off_t)from->max_rotated * from->rotate_kbytes * 1024;
+
+	sink->format = from->format;
+	sink->buffers = from->buffers;
+	sink->buffer_count = from->buffer_count;
+	from->format = format;
+	from->buffers = buffers;
+
+	if (sink->rotate_kbytes > 0 && from->rotate_kbytes == 0) {
+		log_rotate_stop(&sink->rotate);
+	} else if (sink->rotate_kbytes == 0 && from->rotate_kbytes > 0) {
+		if (log_rotate_start(&sink->rotate, sink->filename, budget, true) < 0) {
+			perror("couldn't start log rotation");
+			from->rotate_kbytes = 0;
+		}
+	} else if (sink->rotate_kbytes > 0) {
+		log_rotate_set_budget(&sink->rotate, budget);
+	}
+	sink->rotate_kbytes = from->rotate_kbytes;
+	sink->max_rotated = from->max_rotated;
+
+	freeSink(from);
+}
+
+/* adds dev to the devices epfd waits for */
+static void watchDevice(int epfd, struct log_device_t* dev, bool reading)
+{
+	struct epoll_event ev;
+
+	// the rest is read on every wakeup, until it runs out
+	if (!dev->input.pollable) {
+		return;
+	}
+	ev.events = reading ? EPOLLIN : 0;
+	ev.data.ptr = dev;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, dev->input.fd, &ev) < 0) {
+		perror("epoll_ctl");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Switches to the sinks of the -C file as it is now, between two entries.
+ * A sink writing where a running one does takes over its open output, so
+ * that nothing buffered or queued is lost. If the file has errors, the
+ * running sinks are kept.
+ */
+static void reloadConfig(int epfd, struct log_device_t* devices, bool reading)
+{
+	struct log_sink_t* sinks[MAX_SINKS];
+	int adopt[MAX_SINKS];
+	bool kept[MAX_SINKS] = { false };
+	struct log_device_t* dev;
+	int count, i, j, k;
+
+	count = loadConfig(g_config_path, sinks);
+	if (count < 0) {
+		fprintf(stderr, "%s: not reloaded\n", g_config_path);
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < g_sink_count && (kept[j] || !sameOutput(g_sinks[j], sinks[i])); j++)
+			;
+		adopt[i] = j < g_sink_count ? j : -1;
+		if (adopt[i] >= 0) {
+			kept[j] = true;
+		}
+	}
+	addSinkDevices(sinks, count, &devices);
+
+	// repeats are reported to the sinks that printed the line
+	reportRepeats(INT64_MAX, true);
+	if (g_format_threads > 0) {
+		pausePipeline();
+	}
+
+	for (j = 0; j < g_sink_count; j++) {
+		if (!kept[j]) {
+			closeSink(g_sinks[j]);
+		}
+	}
+	for (i = 0, k = 0; i < count; i++) {
+		if (adopt[i] >= 0) {
+			adoptSink(g_sinks[adopt[i]], sinks[i]);
+			sinks[k++] = g_sinks[adopt[i]];
+		} else if (setup_output(sinks[i]) == 0) {
+			sinks[k++] = sinks[i];
+		} else {
+			fprintf(stderr, "%s: sink %d dropped\n", g_config_path, i + 1);
+			freeSink(sinks[i]);
+		}
+	}
+	memcpy(g_sinks, sinks, k * sizeof(sinks[0]));
+	g_sink_count = k;
+
+	for (dev = devices; dev; dev = dev->next) {
+		if (dev->input.fd < 0 && !dev->ended) {
+			if (log_input_open(&dev->input, dev->device, O_RDONLY | O_NONBLOCK) < 0) {
+				fprintf(stderr, "Unable to open log device '%s': %s\n",
+					dev->device, strerror(errno));
+				dev->ended = true;
+			} else {
+				watchDevice(epfd, dev, reading);
+			}
+		}
+		// what no sink prints may come in any order
+		dev->sinks = sinksOf(dev->device);
+		log_merge_wait(&g_merge, &dev->queue, dev->sinks && !dev->ended);
+	}
+
+	if (g_format_threads > 0) {
+		resumePipeline();
+	}
+	fprintf(stderr, "%s: reloaded\n", g_config_path);
+}
+
+/* prints what is still queued and exits, once there is nothing more to read */
+static void finishLog(struct log_device_t* devices, int* queued_lines)
+{
+	int i;
+
+	printAll(queued_lines);
+	reportRepeats(INT64_MAX, true);
+	if (g_format_threads > 0) {
+		stopPipeline();
+	}
+	if (g_binary) {
+		finishBinaryFile();
+	}
+	flushSinks();
+	for (i = 0; i < g_sink_count; i++) {
+		if (g_sinks[i]->rotate_kbytes > 0) {
+			log_rotate_stop(&g_sinks[i]->rotate);
+		}
+	}
+	printLossSummary(devices);
+	exit(0);
 }
 
-/* returns the readable size of the log's ring buffer (that is, amount of the log consumed) */
-static int get_log_readable_size(int logfd)
+static void read_log_lines(struct log_device_t* devices)
 {
-    return ioctl(logfd, LOGGER_GET_LOG_LEN);
-}
+	struct log_device_t* dev;
+	int queued_lines = 0;
+	int epfd, timeout, flush_timeout, repeats_timeout, result, i;
+	struct epoll_event ev;
+	struct epoll_event events[LOG_ID_MAX + 1];
+	struct timespec now;
+	int64_t mark;
+	uint64_t freed;
+	sigset_t sigs;
+	struct signalfd_siginfo siginfo;
+	int sigfd = -1;
+	bool stalled;
+	bool reading = true;
+	bool ended;
+	bool reload, trigger;
+
+	if (g_format_threads > 0) {
+		startPipeline();
+	}
 
-static void setup_output()
-{
+	// the caller requested to just dump the log and exit
+	if (g_nonblock) {
+		// writers don't wait for a dump to finish, so it reads only the
+		// bytes the rings held now; drivers without the ioctl are read dry
+		for (dev = devices; dev; dev = dev->next) {
+			if (dev->input.kind == LOG_INPUT_DEVICE) {
+				dev->dump_left = get_log_readable_size(dev->input.fd);
+				if (dev->dump_left < 0) {
+					dev->dump_left = -1;
+				}
+			}
+		}
 
-    if (g_output_filename == NULL) {
-        g_outfd = STDOUT_FILENO;
+		// a paused dump prints what it has, then reads on
+		do {
+			g_paused = false;
+			for (dev = devices; dev; dev = dev->next) {
+				drainDevice(dev, devices, &queued_lines);
+			}
+			reportDropped(devices, true);
+			printAll(&queued_lines);
+		} while (g_paused);
+		finishLog(devices, &queued_lines);
+	}
 
-    } else {
-        struct stat statbuf;
+	epfd = epoll_create(g_dev_count);
+	if (epfd < 0) {
+		perror("epoll_create");
+		exit(EXIT_FAILURE);
+	}
+	for (dev = devices; dev; dev = dev->next) {
+		watchDevice(epfd, dev, true);
+	}
+	if (g_config_path || g_window_kbytes > 0) {
+		// SIGHUP and SIGUSR1 are blocked since before any thread started
+		sigemptyset(&sigs);
+		if (g_config_path) {
+			sigaddset(&sigs, SIGHUP);
+		}
+		if (g_window_kbytes > 0) {
+			sigaddset(&sigs, SIGUSR1);
+		}
+		sigfd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+		if (sigfd < 0) {
+			perror("signalfd");
+			exit(EXIT_FAILURE);
+		}
+		ev.events = EPOLLIN;
+		ev.data.ptr = &sigfd;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev) < 0) {
+			perror("epoll_ctl");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (g_format_threads > 0) {
+		// written batches coming back can unblock the reader
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, g_free_batches.wake_fd, &ev) < 0) {
+			perror("epoll_ctl");
+			exit(EXIT_FAILURE);
+		}
+	}
 
-        g_outfd = open_logfile (g_output_filename);
+	timeout = 0;
+	while (1) {
+		// nothing queued means no timeout at all: an idle system never wakes us
+		result = epoll_wait(epfd, events, LOG_ID_MAX + 1, timeout);
+		if (result < 0 && errno != EINTR) {
+			perror("epoll_wait");
+			exit(EXIT_FAILURE);
+		}
+		if (g_format_threads > 0 && read(g_free_batches.wake_fd, &freed, sizeof(freed)) < 0) {
+			// nothing was written back since last time
+		}
+		for (i = 0; i < result; i++) {
+			if (events[i].data.ptr == &sigfd) {
+				reload = trigger = false;
+				while (read(sigfd, &siginfo, sizeof(siginfo)) == sizeof(siginfo)) {
+					reload = reload || siginfo.ssi_signo == SIGHUP;
+					trigger = trigger || siginfo.ssi_signo == SIGUSR1;
+				}
+				if (reload) {
+					reloadConfig(epfd, devices, reading);
+				}
+				if (trigger) {
+					// live capture may have been quiet for a while
+					clock_gettime(CLOCK_REALTIME, &now);
+					mark = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+					fireTrigger("SIGUSR1", g_newest_nsec > mark ? g_newest_nsec : mark);
+				}
+			}
+		}
 
-        if (g_outfd < 0) {
-            perror ("couldn't open output file");
-            exit(-1);
-        }
+		if (g_paused && !overBudget(queueLowWater())) {
+			g_paused = false;
+		}
 
-        fstat(g_outfd, &statbuf);
+		// every device is drained after this point, so anything written
+		// before it, give or take the reorder window, has been read
+		clock_gettime(CLOCK_REALTIME, &now);
+		ended = true;
+		for (dev = devices; dev; dev = dev->next) {
+			drainDevice(dev, devices, &queued_lines);
+			ended = ended && dev->ended;
+		}
+		if (ended) {
+			finishLog(devices, &queued_lines);
+		}
+		if (reading == g_paused) {
+			// while paused, the drivers overwrite what isn't read, and
+			// the sequence numbers report it as lost
+			reading = !g_paused;
+			setReading(epfd, devices, reading);
+		}
 
-        g_out_byte_count = statbuf.st_size;
-    }
-}
+		reportDropped(devices, false);
+		stalled = false;
+		while ((dev = chooseReady(&now)) != NULL) {
+			if (!readyToPrint(false)) {
+				stalled = true;
+				break;
+			}
+			printNextEntry(dev);
+			--queued_lines;
+		}
+		if (!stalled) {
+			mark = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec - (int64_t)g_reorder_msec * 1000000;
+			stalled = !reportRepeats(mark, false);
+		}
 
-static int set_log_format(const char * formatString)
-{
-	static log_print_format format;
+		if (g_format_threads > 0) {
+			// the writer thread owns the output and its flush deadline
+			dispatchBatch();
+			timeout = stalled ? -1 : nextReadyTimeout(&now);
+		} else {
+			// terminals see every batch at once, files and pipes only once
+			// the buffer fills up or its oldest line is flush_msec old
+			for (i = 0; i < g_sink_count; i++) {
+				if (log_output_batch_done(&g_sinks[i]->output) < 0) {
+					perror("output error");
+					exit(-1);
+				}
+			}
 
-	format = log_format_from_string(formatString);
+			timeout = nextReadyTimeout(&now);
+			flush_timeout = sinksTimeout(false);
+			if (flush_timeout >= 0 && (timeout < 0 || flush_timeout < timeout)) {
+				timeout = flush_timeout;
+			}
+		}
+		repeats_timeout = stalled ? -1 : nextRepeatsTimeout(&now);
+		if (repeats_timeout >= 0 && (timeout < 0 || repeats_timeout < timeout)) {
+			timeout = repeats_timeout;
+		}
 
-	if (format == FORMAT_OFF) {
-		// FORMAT_OFF means invalid string
-		return -1;
+		// trade latency for fewer, larger batches under load
+		if (g_batch_msec > 0) {
+			struct timespec batch = { g_batch_msec / 1000, (g_batch_msec % 1000) * 1000000 };
+			while (nanosleep(&batch, &batch) < 0 && errno == EINTR)
+				;
+		}
 	}
-
-	log_set_print_format(g_logformat, format);
-
-	return 0;
 }
 
+
 static void show_help(const char *cmd)
 {
     fprintf(stderr,"Usage: %s [options] [filterspecs]\n", cmd);
@@ -400,7 +2352,22 @@ static void show_help(const char *cmd)
                     "                  Like specifying filterspec '*:s'\n"
                     "  -f <filename>   Log to file. Default to stdout\n"
                     "  -r [<kbytes>]   Rotate log every kbytes. (16 if unspecified). Requires -f\n"
-                    "  -n <count>      Sets max number of rotated logs to <count>, default 4\n"
+                    "  -n <count>      Keep rotated logs up to <count> times the -r size,\n"
+                    "                  counted after compression, default 4\n"
+                    "  -m <kbytes>     Keep the log in a circular file of <kbytes> instead of\n"
+                    "                  rotating it. Requires -f\n"
+                    "  -M <filename>   Print a circular log file written with -m and exit\n"
+                    "  -B              Write a binary capture instead of formatted lines.\n"
+                    "                  Rotated files are not compressed\n"
+                    "  -S              Like -B, and index every file for queries with -F.\n"
+                    "                  Requires -f\n"
+                    "  -F <filename>   Print a binary capture written with -B and exit.\n"
+                    "                  Rotated files are printed first\n"
+                    "  --since <time>, --until <time>\n"
+                    "                  With -F, print entries from <time> on, or up to it.\n"
+                    "                  <time> is [YYYY-]MM-DD HH:MM:SS[.fff] or @<seconds>\n"
+                    "  --tag <tag>     With -F, print entries of <tag> only\n"
+                    "  --pid <pid>     With -F, print entries of <pid> only\n"
                     "  -v <format>     Sets the log print format, where <format> is one of:\n\n"
                     "                  brief process tag thread raw time threadtime long\n\n"
                     "  -c              clear (flush) the entire log and exit\n"
@@ -408,7 +2375,35 @@ static void show_help(const char *cmd)
                     "  -t <count>      print only the most recent <count> lines (implies -d)\n"
                     "  -g              get the size of the log's ring buffer and exit\n"
                     "  -b <buffer>     request alternate ring buffer\n"
-                    "                  ('main' (default), 'radio', 'system')");
+                    "                  ('main' (default), 'radio', 'system'), or read\n"
+                    "                  entries from '-' (stdin), 'stream:<file>',\n"
+                    "                  'unix:<socket>' or 'capture:<file>'\n"
+                    "  -w <msec>       Wait up to <msec> for late entries of other buffers\n"
+                    "                  before printing out of order, default 20\n"
+                    "  -l <msec>       Collect entries for <msec> after a wakeup to print them\n"
+                    "                  in larger batches, default 0\n"
+                    "  -j <threads>    Format lines on <threads> threads and write them on\n"
+                    "                  another, default 0 (all on the reading thread), or\n"
+                    "                  one per CPU with -F\n"
+                    "  -q <Kbytes>     Keep at most <Kbytes> of entries queued, default no limit\n"
+                    "  --drop <policy> Over the -q limit, drop the lowest 'priority' entries\n"
+                    "                  (default) or the 'oldest', or 'pause' reading\n"
+                    "  -u <msec>       Print a line repeated by the same pid within <msec> once,\n"
+                    "                  then how many times it was repeated\n"
+                    "  --sink <options> Also write to another sink, with its own -b, -f, -r,\n"
+                    "                  -n, -m, -v, -s and filterspecs in <options>, e.g.\n"
+                    "                  --sink '-b radio -f /var/log/radio -r 1024 *:V'.\n"
+                    "                  Its buffers default to those of the options above\n"
+                    "  -C <file>       Write to the sinks of <file>, one per line, given like\n"
+                    "                  --sink options. Reloaded on SIGHUP\n"
+                    "  --io <engine>   Write files with 'sync' write() calls (default), or\n"
+                    "                  queue them to 'uring', io_uring, if the kernel can\n"
+                    "  --window <Kbytes> Keep the last <Kbytes> of entries in memory, and print\n"
+                    "                  them only when a trigger or SIGUSR1 comes\n"
+                    "  --trigger <filterspecs> Entries that trigger, default '*:E'\n"
+                    "  --match <text>  Entries with <text> in their message trigger too\n"
+                    "  --post <msec>   After a trigger, print everything for <msec>,\n"
+                    "                  default 5000");
 
 
     fprintf(stderr,"\nfilterspecs are a series of \n"
@@ -430,6 +2425,93 @@ static void show_help(const char *cmd)
 }
 
 
+/*
+ * Parses "[YYYY-]MM-DD HH:MM:SS[.fff]" in local time, as printed by the
+ * time formats, or "@<seconds since Epoch>[.fff]", into nsec. With end,
+ * the result is the last nsec of the time given, so that an --until taken
+ * from a printed line includes that line.
+ */
+static int parse_time(const char* str, int64_t* nsec, bool end)
+{
+	struct tm tm;
+	time_t now, sec;
+	long long epoch;
+	int64_t frac = 0;
+	int scale = 100000000;
+	int year, mon, day, hour, min, secs;
+	int n = 0;
+
+	if (sscanf(str, "@%lld%n", &epoch, &n) == 1) {
+		sec = (time_t)epoch;
+	} else {
+		// the time formats leave out the year
+		now = time(NULL);
+		localtime_r(&now, &tm);
+		year = tm.tm_year + 1900;
+		if (sscanf(str, "%d-%d-%d %d:%d:%d%n", &year, &mon, &day, &hour, &min, &secs, &n) != 6) {
+			year = tm.tm_year + 1900;
+			n = 0;
+			if (sscanf(str, "%d-%d %d:%d:%d%n", &mon, &day, &hour, &min, &secs, &n) != 5) {
+				return -1;
+			}
+		}
+		tm.tm_year = year - 1900;
+		tm.tm_mon = mon - 1;
+		tm.tm_mday = day;
+		tm.tm_hour = hour;
+		tm.tm_min = min;
+		tm.tm_sec = secs;
+		tm.tm_isdst = -1;
+		sec = mktime(&tm);
+	}
+
+	str += n;
+	if (*str == '.') {
+		for (str++; isdigit(*str); str++) {
+			frac += (*str - '0') * scale;
+			scale /= 10;
+		}
+	}
+	if (*str != '\0' || n == 0) {
+		return -1;
+	}
+	*nsec = (int64_t)sec * 1000000000 + frac;
+	if (end) {
+		*nsec += (int64_t)scale * 10 - 1;
+	}
+
+	return 0;
+}
+
+enum {
+	OPT_SINCE = 256,
+	OPT_UNTIL,
+	OPT_TAG,
+	OPT_PID,
+	OPT_DROP,
+	OPT_SINK,
+	OPT_IO,
+	OPT_WINDOW,
+	OPT_TRIGGER,
+	OPT_MATCH,
+	OPT_POST,
+};
+
+static const struct option long_options[] = {
+	{ "since", required_argument, NULL, OPT_SINCE },
+	{ "until", required_argument, NULL, OPT_UNTIL },
+	{ "tag", required_argument, NULL, OPT_TAG },
+	{ "pid", required_argument, NULL, OPT_PID },
+	{ "drop", required_argument, NULL, OPT_DROP },
+	{ "sink", required_argument, NULL, OPT_SINK },
+	{ "io", required_argument, NULL, OPT_IO },
+	{ "window", required_argument, NULL, OPT_WINDOW },
+	{ "trigger", required_argument, NULL, OPT_TRIGGER },
+	{ "match", required_argument, NULL, OPT_MATCH },
+	{ "post", required_argument, NULL, OPT_POST },
+	{ NULL, 0, NULL, 0 }
+};
+
 int main(int argc, char **argv)
 {
     int err;
@@ -437,12 +2519,20 @@ int main(int argc, char **argv)
     int is_clear_log = 0;
     int getLogSize = 0;
     int mode = O_RDONLY;
-	int i;
+    const char *binaryInput = NULL;
+    const char *sinkSpecs[MAX_SINKS];
+    bool drop_set = false;
+    bool triggers_set = false;
+    bool trigger_filters = false;
+    bool outputOptions = false;
+	int i, filters;
 //    const char *forceFilters = NULL;
 	struct log_device_t* devices = NULL;
 	struct log_device_t* dev;
 
-    g_logformat = (log_format *)log_format_new();
+    g_sinks[0] = newSink();
+    g_triggers = log_format_new();
+    log_arena_init(&g_arena);
 
     if (argc == 2 && 0 == strcmp(argv[1], "--test")) {
         logprint_run_tests();
@@ -457,7 +2547,7 @@ int main(int argc, char **argv)
     for (;;) {
         int ret;
 
-        ret = getopt(argc, argv, "cdt:gsf:r:n:v:b:D");
+        ret = getopt_long(argc, argv, "cdt:gsf:r:n:m:M:BSF:v:b:w:l:j:q:u:C:D", long_options, NULL);
 
         if (ret < 0) {
             break;
@@ -466,7 +2556,8 @@ int main(int argc, char **argv)
         switch(ret) {
             case 's':
                 // default to all silent
-                log_add_filter_rule(g_logformat, "*:s");
+                log_add_filter_rule(g_sinks[0]->format, "*:s");
+                outputOptions = true;
             break;
 
             case 'c':
@@ -489,43 +2580,23 @@ int main(int argc, char **argv)
             break;
 
 			case 'b': {
-						  char* buf = (char*) malloc(strlen(LOG_FILE_DIR) + strlen(optarg) + 1);
+						  char* buf = log_input_name(optarg);
 						  if (buf == NULL) {
 							  fprintf(stderr,"Can't malloc LOG_FILE_DIR\n");
 							  exit(-1);
 						  }
-						  strcpy(buf, LOG_FILE_DIR);
-						  strcat(buf, optarg);
-						  //		snprintf(buf, strlen(LOG_FILE_DIR) + strlen(optarg) + 1, "%s%s", LOG_FILE_DIR, optarg);
 
                 if (devices) {
 					dev = devices;
                     while (dev->next) {
 						dev = dev->next;
 					}
-					dev->next = (struct log_device_t *)malloc( sizeof(struct log_device_t));
-					if (dev->next == NULL) {
-						fprintf(stderr,"Can't malloc log_device\n");
-						exit(-1);
-					}
-					dev->next->device = buf;
-					dev->next->fd = -1;
-					dev->next->printed = false;
-					dev->next->queue = NULL;
-					dev->next->next = NULL;
+					dev->next = new_log_device(buf);
 
                 } else {
-					devices = (struct log_device_t *)malloc( sizeof(struct log_device_t));
-					if (devices == NULL) {
-						fprintf(stderr,"Can't malloc log_device\n");
-						exit(-1);
-					}
-					devices->device = buf;
-					devices->fd = -1;
-					devices->printed = false;
-					devices->queue = NULL;
-					devices->next = NULL;
+					devices = new_log_device(buf);
                 }
+                addBuffer(&g_default_buffers, &g_default_buffer_count, buf);
                 g_dev_count++;
             }
             break;
@@ -533,14 +2604,15 @@ int main(int argc, char **argv)
             case 'f':
                 // redirect output to a file
 
-                g_output_filename = optarg;
+                g_sinks[0]->filename = strdup(optarg);
+                outputOptions = true;
 
             break;
 
             case 'r':
 //                if (optarg == NULL) {
 //					fprintf(stderr,"optarg == null\n");
- //                  g_log_rotate_size_kbytes = DEFAULT_LOG_ROTATE_SIZE_KBYTES;
+ //                  g_sinks[0]->rotate_kbytes = DEFAULT_LOG_ROTATE_SIZE_KBYTES;
  //              } else {
                     //long logRotateSize;
                     //char *lastDigit;
@@ -550,7 +2622,8 @@ int main(int argc, char **argv)
                         show_help(argv[0]);
                         exit(-1);
                     }
-                    g_log_rotate_size_kbytes = atoi(optarg);
+                    g_sinks[0]->rotate_kbytes = atoi(optarg);
+                    outputOptions = true;
    //             }
             break;
 
@@ -561,11 +2634,192 @@ int main(int argc, char **argv)
                     exit(-1);
                 }
 
-                g_max_rotated_logs = atoi(optarg);
+                g_sinks[0]->max_rotated = atoi(optarg);
+                outputOptions = true;
+            break;
+
+            case 'w':
+                if (!isdigit(optarg[0])) {
+                    fprintf(stderr,"Invalid parameter to -w\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_reorder_msec = atoi(optarg);
+            break;
+
+            case 'l':
+                if (!isdigit(optarg[0])) {
+                    fprintf(stderr,"Invalid parameter to -l\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_batch_msec = atoi(optarg);
+            break;
+
+            case 'j':
+                if (!isdigit(optarg[0]) || atoi(optarg) > 64) {
+                    fprintf(stderr,"Invalid parameter to -j\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_format_threads = atoi(optarg);
+            break;
+
+            case 'm':
+                if (!isdigit(optarg[0]) || atoi(optarg) <= 0) {
+                    fprintf(stderr,"Invalid parameter to -m\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_sinks[0]->ring_kbytes = atoi(optarg);
+                outputOptions = true;
+            break;
+
+            case 'M':
+                if (log_ring_print(optarg, STDOUT_FILENO) < 0) {
+                    fprintf(stderr, "Unable to read ring file '%s': %s\n",
+                        optarg, strerror(errno));
+                    exit(-1);
+                }
+                exit(0);
+            break;
+
+            case 'B':
+                g_binary = true;
+                outputOptions = true;
+            break;
+
+            case 'S':
+                g_binary = true;
+                g_store = true;
+                outputOptions = true;
+            break;
+
+            case 'F':
+                binaryInput = optarg;
+            break;
+
+            case OPT_SINCE:
+            case OPT_UNTIL:
+                if (parse_time(optarg, ret == OPT_SINCE ? &g_since_nsec : &g_until_nsec, ret == OPT_UNTIL) < 0) {
+                    fprintf(stderr,"Invalid time '%s'\n", optarg);
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+            break;
+
+            case OPT_TAG:
+                g_query_tag = optarg;
+            break;
+
+            case OPT_PID:
+                if (!isdigit(optarg[0])) {
+                    fprintf(stderr,"Invalid parameter to --pid\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_query_pid = atoi(optarg);
+            break;
+
+            case OPT_DROP:
+                if (!strcmp(optarg, "priority")) {
+                    g_drop_policy = DROP_PRIORITY;
+                } else if (!strcmp(optarg, "oldest")) {
+                    g_drop_policy = DROP_OLDEST;
+                } else if (!strcmp(optarg, "pause")) {
+                    g_drop_policy = DROP_PAUSE;
+                } else {
+                    fprintf(stderr,"Invalid parameter to --drop\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                drop_set = true;
+            break;
+
+            case OPT_SINK:
+                if (g_sink_count >= MAX_SINKS) {
+                    fprintf(stderr,"Too many --sink options, at most %d\n", MAX_SINKS - 1);
+                    exit(-1);
+                }
+                sinkSpecs[g_sink_count++] = optarg;
+                outputOptions = true;
+            break;
+
+            case 'C':
+                g_config_path = optarg;
+            break;
+
+            case OPT_WINDOW:
+                if (!isdigit(optarg[0]) || atoi(optarg) <= 0) {
+                    fprintf(stderr,"Invalid parameter to --window\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_window_kbytes = atoi(optarg);
+            break;
+
+            case OPT_TRIGGER:
+                if (log_add_filter_string(g_triggers, optarg) < 0) {
+                    fprintf(stderr,"Invalid parameter to --trigger\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                triggers_set = true;
+                trigger_filters = true;
+            break;
+
+            case OPT_MATCH:
+                if (optarg[0] == '\0') {
+                    fprintf(stderr,"Invalid parameter to --match\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_trigger_match = optarg;
+                triggers_set = true;
+            break;
+
+            case OPT_POST:
+                if (!isdigit(optarg[0])) {
+                    fprintf(stderr,"Invalid parameter to --post\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_post_msec = atoi(optarg);
+                triggers_set = true;
+            break;
+
+            case OPT_IO:
+                if (!strcmp(optarg, "uring")) {
+                    g_io_uring = true;
+                } else if (!strcmp(optarg, "sync")) {
+                    g_io_uring = false;
+                } else {
+                    fprintf(stderr,"Invalid parameter to --io\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+            break;
+
+            case 'q':
+                if (!isdigit(optarg[0]) || atoi(optarg) <= 0) {
+                    fprintf(stderr,"Invalid parameter to -q\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_queue_budget = (size_t)atoi(optarg) * 1024;
+            break;
+
+            case 'u':
+                if (!isdigit(optarg[0]) || atoi(optarg) <= 0) {
+                    fprintf(stderr,"Invalid parameter to -u\n");
+                    show_help(argv[0]);
+                    exit(-1);
+                }
+                g_dedup_msec = atoi(optarg);
             break;
 
             case 'v':
-                err = set_log_format (optarg);
+                err = set_log_format(g_sinks[0]->format, optarg);
                 if (err < 0) {
                     fprintf(stderr,"Invalid parameter to -v\n");
                     show_help(argv[0]);
@@ -573,6 +2827,7 @@ int main(int argc, char **argv)
                 }
 
                 has_set_log_format = 1;
+                outputOptions = true;
             break;
 
 			default:
@@ -583,17 +2838,8 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (!devices) {
-        devices = (struct log_device_t *)malloc( sizeof(struct log_device_t));
-		if (devices == NULL) {
-			fprintf(stderr,"Can't malloc log_device\n");
-			exit(-1);
-		}
-		devices->device = strdup("/dev/"LOGGER_LOG_MAIN);
-		devices->fd = -1;
-		devices->printed = false;
-		devices->queue = NULL;
-		devices->next = NULL;
+	if (!devices && !binaryInput) {
+        devices = new_log_device(strdup("/dev/"LOGGER_LOG_MAIN));
         g_dev_count = 1;
 
 
@@ -603,41 +2849,18 @@ int main(int argc, char **argv)
 
         // only add this if it's available
 	if (0 == access("/dev/"LOGGER_LOG_SYSTEM, accessmode)) {
-		devices->next = (struct log_device_t *)malloc( sizeof(struct log_device_t));
-		if (devices->next == NULL) {
-			fprintf(stderr,"Can't malloc log_device\n");
-			exit(-1);
-		}
-		devices->next->device = strdup("/dev/"LOGGER_LOG_SYSTEM);
-		devices->next->fd = -1;
-		devices->next->printed = false;
-		devices->next->queue = NULL;
-		devices->next->next = NULL;
+		devices->next = new_log_device(strdup("/dev/"LOGGER_LOG_SYSTEM));
 		g_dev_count ++;
 	}
 	if (0 == access("/dev/"LOGGER_LOG_APPS, accessmode)) {
-		devices->next = (struct log_device_t *)malloc( sizeof(struct log_device_t));
-		if (devices->next == NULL) {
-			fprintf(stderr,"Can't malloc log_device\n");
-			exit(-1);
-		}
-		devices->next->device = strdup("/dev/"LOGGER_LOG_APPS);
-		devices->next->fd = -1;
-		devices->next->printed = false;
-		devices->next->queue = NULL;
-		devices->next->next = NULL;
+		devices->next = new_log_device(strdup("/dev/"LOGGER_LOG_APPS));
 		g_dev_count ++;
 	}
 /*
         // only add this if it's available
 	int fd;
 	if ((fd = open("/dev/"LOGGER_LOG_SYSTEM, mode)) != -1) {
-		devices->next = (struct log_device_t *)malloc( sizeof(struct log_device_t));
-		devices->next->device = strdup("/dev/"LOGGER_LOG_SYSTEM);
-		devices->next->fd = -1;
-		devices->next->printed = false;
-		devices->next->queue = NULL;
-		devices->next->next = NULL;
+		devices->next = new_log_device(strdup("/dev/"LOGGER_LOG_SYSTEM));
 		g_dev_count ++;
 
 		close(fd);
@@ -645,24 +2868,160 @@ int main(int argc, char **argv)
 */
     }
 
-    if (g_log_rotate_size_kbytes != 0 && g_output_filename == NULL)
+    if (g_config_path && (outputOptions || optind < argc))
+	{
+		fprintf(stderr,"-C can't be used with -f, -r, -n, -m, -v, -s, -B, -S, --sink or filterspecs\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    // without -b, sinks take the default buffers
+    if (g_default_buffer_count == 0) {
+        for (dev = devices; dev; dev = dev->next) {
+            addBuffer(&g_default_buffers, &g_default_buffer_count, dev->device);
+        }
+    }
+    // the filterspecs of the first sink are still to come from argv
+    filters = optind;
+    if (g_config_path) {
+        freeSink(g_sinks[0]);
+        g_sink_count = loadConfig(g_config_path, g_sinks);
+        if (g_sink_count < 0) {
+            exit(-1);
+        }
+    } else {
+        for (i = 0; i < g_default_buffer_count; i++) {
+            addBuffer(&g_sinks[0]->buffers, &g_sinks[0]->buffer_count, g_default_buffers[i]);
+        }
+        for (i = 1; i < g_sink_count; i++) {
+            char where[16 + strlen(sinkSpecs[i])];
+
+            snprintf(where, sizeof(where), "--sink '%s'", sinkSpecs[i]);
+            g_sinks[i] = parseSink(sinkSpecs[i], where);
+            if (g_sinks[i] == NULL) {
+                show_help(argv[0]);
+                exit(-1);
+            }
+        }
+    }
+    optind = filters;
+    if (!binaryInput) {
+        addSinkDevices(g_sinks, g_sink_count, &devices);
+    }
+    for (dev = devices; dev; dev = dev->next) {
+        dev->sinks = sinksOf(dev->device);
+        log_merge_wait(&g_merge, &dev->queue, dev->sinks != 0);
+    }
+
+    if (g_sinks[0]->rotate_kbytes != 0 && g_sinks[0]->filename == NULL)
 	{
 		fprintf(stderr,"-r requires -f as well\n");
 		show_help(argv[0]);
 		exit(-1);
 	}
 
-    setup_output();
+    if (g_sinks[0]->ring_kbytes != 0 && (g_sinks[0]->filename == NULL || g_sinks[0]->rotate_kbytes != 0))
+	{
+		fprintf(stderr,"-m requires -f, and can't be used with -r\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    if (g_binary && (g_sinks[0]->ring_kbytes != 0 || binaryInput))
+	{
+		fprintf(stderr,"-B and -S can't be used with -m or -F\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    if (g_format_threads > 0 && g_binary)
+	{
+		fprintf(stderr,"-j can't be used with -B or -S\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    if (g_dedup_msec > 0 && g_binary)
+	{
+		fprintf(stderr,"-u can't be used with -B or -S\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    // converting a capture is only bound by formatting, so it uses every
+    // core unless told otherwise
+    if (g_format_threads < 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        g_format_threads = binaryInput && !g_binary && cpus > 1 ? (cpus > 64 ? 64 : cpus) : 0;
+    }
+
+    if (drop_set && g_queue_budget == 0)
+	{
+		fprintf(stderr,"--drop requires -q as well\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    if (g_store && g_sinks[0]->filename == NULL)
+	{
+		fprintf(stderr,"-S requires -f as well\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    if (triggers_set && g_window_kbytes == 0)
+	{
+		fprintf(stderr,"--trigger, --match and --post require --window as well\n");
+		show_help(argv[0]);
+		exit(-1);
+	}
+
+    if (g_window_kbytes > 0) {
+        // errors trigger unless told otherwise
+        if (!trigger_filters && g_trigger_match == NULL) {
+            log_add_filter_rule(g_triggers, "*:E");
+        }
+        if (log_window_init(&g_window, (size_t)g_window_kbytes * 1024) < 0) {
+            fprintf(stderr,"Can't malloc window\n");
+            exit(-1);
+        }
+    }
+
+    if (g_binary) {
+        setBinaryHeader(devices);
+    }
+
+    // SIGHUP and SIGUSR1 are taken through a signalfd; every thread must
+    // block them
+    if ((g_config_path || g_window_kbytes > 0) && !g_nonblock) {
+        sigset_t sigs;
+
+        sigemptyset(&sigs);
+        if (g_config_path) {
+            sigaddset(&sigs, SIGHUP);
+        }
+        if (g_window_kbytes > 0) {
+            sigaddset(&sigs, SIGUSR1);
+        }
+        sigprocmask(SIG_BLOCK, &sigs, NULL);
+    }
+
+    for (i = 0; i < g_sink_count; i++) {
+        if (setup_output(g_sinks[i]) < 0) {
+            exit(-1);
+        }
+    }
 
 
-	if (has_set_log_format == 0) {
-		err = set_log_format("brief");
+	// a -C file sets the format and filters of all its sinks
+	if (has_set_log_format == 0 && !g_config_path) {
+		err = set_log_format(g_sinks[0]->format, "brief");
 	}
 /*
 		const char* logFormat = getenv("DLOG_PRINTF_LOG");
 
 	        if (logFormat != NULL) {
-			err = set_log_format("brief");
+			err = set_log_format(g_sinks[0]->format, "brief");
 
 			if (err < 0) {
 				fprintf(stderr, "invalid format in DLOG_PRINTF_LOG '%s'\n", logFormat);
@@ -670,7 +3029,7 @@ int main(int argc, char **argv)
 		}
 	}
 	if (forceFilters) {
-		err = log_add_filter_string(g_logformat, forceFilters);
+		err = log_add_filter_string(g_sinks[0]->format, forceFilters);
 		if (err < 0) {
 			fprintf (stderr, "Invalid filter expression in -logcat option\n");
 			exit(0);
@@ -680,7 +3039,7 @@ int main(int argc, char **argv)
 		char *env_tags_orig = getenv("DLOG_LOG_TAGS");
 
 		if (env_tags_orig != NULL) {
-			err = log_add_filter_string(g_logformat, env_tags_orig);
+			err = log_add_filter_string(g_sinks[0]->format, env_tags_orig);
 
 			if (err < 0) {
 				fprintf(stderr, "Invalid filter expression in DLOG_LOG_TAGS\n");
@@ -691,19 +3050,19 @@ int main(int argc, char **argv)
 	} else {
         // Add from commandline
 */
-	fprintf(stderr,"arc = %d, optind = %d ,Kb %d, rotate %d\n", argc, optind,g_log_rotate_size_kbytes,g_max_rotated_logs);
+	fprintf(stderr,"arc = %d, optind = %d ,Kb %d, rotate %d\n", argc, optind,g_sinks[0]->rotate_kbytes,g_sinks[0]->max_rotated);
 
-	if(argc == optind )
+	if(argc == optind && !g_config_path)
 	{
 		// Add from environment variable
         //char *env_tags_orig = getenv("DLOG_TAGS");
-		log_add_filter_string(g_logformat, "*:d");
+		log_add_filter_string(g_sinks[0]->format, "*:d");
 	}
 	else
 	{
 
 		for (i = optind ; i < argc ; i++) {
-			err = log_add_filter_string(g_logformat, argv[i]);
+			err = log_add_filter_string(g_sinks[0]->format, argv[i]);
 
 			if (err < 0) {
 				fprintf (stderr, "Invalid filter expression '%s'\n", argv[i]);
@@ -715,10 +3074,14 @@ int main(int argc, char **argv)
 /*
     }
 */
+    if (binaryInput) {
+        read_binary_capture(binaryInput);
+        exit(0);
+    }
+
     dev = devices;
     while (dev) {
-        dev->fd = open(dev->device, mode);
-        if (dev->fd < 0) {
+        if (log_input_open(&dev->input, dev->device, is_clear_log ? mode : mode | O_NONBLOCK) < 0) {
             fprintf(stderr, "Unable to open log device '%s': %s\n",
                 dev->device, strerror(errno));
             exit(EXIT_FAILURE);
@@ -726,7 +3089,7 @@ int main(int argc, char **argv)
 
         if (is_clear_log) {
             int ret;
-            ret = clear_log(dev->fd);
+            ret = clear_log(dev->input.fd);
             if (ret) {
                 perror("ioctl");
                 exit(EXIT_FAILURE);
@@ -736,13 +3099,13 @@ int main(int argc, char **argv)
         if (getLogSize) {
             int size, readable;
 
-            size = get_log_size(dev->fd);
+            size = get_log_size(dev->input.fd);
             if (size < 0) {
                 perror("ioctl");
                 exit(EXIT_FAILURE);
             }
 
-            readable = get_log_readable_size(dev->fd);
+            readable = get_log_readable_size(dev->input.fd);
             if (readable < 0) {
                 perror("ioctl");
                 exit(EXIT_FAILURE);
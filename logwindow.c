@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <logbinary.h>
+#include <logwindow.h>
+
+int log_window_init(struct log_window_t* window, size_t size)
+{
+	memset(window, 0, sizeof(*window));
+	if (size < 2 * LOG_BINARY_RECORD_MAX) {
+		size = 2 * LOG_BINARY_RECORD_MAX;
+	}
+	window->buf = (char *)malloc(size);
+	if (window->buf == NULL) {
+		return -1;
+	}
+	window->size = size;
+
+	return 0;
+}
+
+/* returns the length of the record at the head */
+static size_t head_length(const struct log_window_t* window)
+{
+	const unsigned char* p = (const unsigned char *)window->buf + window->head;
+	const unsigned char* end = (const unsigned char *)window->buf
+		+ (window->wrapped ? window->wrap : window->tail);
+	uint64_t v = 0;
+	size_t len = 0;
+	int i;
+
+	// buffer, timestamp, pid, tid, then the payload length
+	for (i = 0; i < 5; i++) {
+		len += log_binary_get_varint(p + len, end, &v);
+	}
+
+	return len + v;
+}
+
+static size_t varint_length(uint64_t value)
+{
+	size_t n = 1;
+
+	while (value >= 0x80) {
+		value >>= 7;
+		n++;
+	}
+
+	return n;
+}
+
+static void drop_oldest(struct log_window_t* window)
+{
+	window->head += head_length(window);
+	window->count--;
+	if (window->wrapped && window->head == window->wrap) {
+		window->head = 0;
+		window->wrapped = 0;
+	}
+	if (window->count == 0) {
+		window->head = 0;
+		window->tail = 0;
+		window->wrapped = 0;
+	}
+}
+
+void log_window_add(struct log_window_t* window, int buffer, const struct logger_entry* entry)
+{
+	// records are stored with their whole timestamp, so that any of
+	// them can be dropped without the next losing its own
+	struct log_binary_writer_t writer = { 0 };
+	int64_t nsec = (int64_t)entry->sec * 1000000000 + entry->nsec;
+	size_t len;
+
+	len = varint_length(buffer) + varint_length(log_binary_zigzag(nsec))
+		+ varint_length((uint32_t)entry->pid) + varint_length((uint32_t)entry->tid)
+		+ varint_length(entry->len) + entry->len;
+
+	for (;;) {
+		if (!window->wrapped) {
+			if (window->size - window->tail >= len) {
+				break;
+			}
+			window->wrap = window->tail;
+			window->tail = 0;
+			window->wrapped = 1;
+		}
+		if (window->head - window->tail >= len) {
+			break;
+		}
+		drop_oldest(window);
+	}
+	window->tail += log_binary_encode(&writer, window->buf + window->tail, buffer, entry);
+	window->count++;
+}
+
+int log_window_take(struct log_window_t* window, int* buffer, struct logger_entry* entry)
+{
+	int64_t nsec = 0;
+	const unsigned char* p;
+	const unsigned char* end;
+
+	if (window->count == 0) {
+		return 0;
+	}
+	p = (const unsigned char *)window->buf + window->head;
+	end = (const unsigned char *)window->buf + (window->wrapped ? window->wrap : window->tail);
+	log_binary_decode(p, end, &nsec, buffer, entry);
+	drop_oldest(window);
+
+	return 1;
+}
+
+void log_window_free(struct log_window_t* window)
+{
+	free(window->buf);
+	memset(window, 0, sizeof(*window));
+}